@@ -1,19 +1,109 @@
 #include "FloatImageViewer.hpp"
 #include "FloatTexture.hpp"
 
+#include <QFileInfo>
+#include <QMatrix4x4>
 #include <QSGFlatColorMaterial>
 #include <QSGGeometry>
 #include <QSGSimpleMaterialShader>
 #include <QSGTexture>
+#include <QSGTransformNode>
 #include <QThreadPool>
+#include <QQuickWindow>
 
 #include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <limits>
+#include <stdexcept>
 #include <vector>
 #include <utility>
 
 namespace qtAliceVision {
 
+namespace {
+
+/// Maximum number of flipbook textures uploaded ahead of time per rendered frame
+constexpr int maxFlipbookUploadsPerFrame = 2;
+
+/// Maximum number of pixels returned by a single pixel probing request (256 MB of RGBA floats)
+constexpr qint64 maxProbedPixels = 4096 * 4096;
+
+/// Frame time drawn at the top of the render stats graph, in milliseconds
+constexpr double renderStatsGraphMaxTime = 50.0;
+
+/// Frame time budget highlighted in the render stats graph (60 fps), in milliseconds
+constexpr double renderStatsFrameBudget = 1000.0 / 60.0;
+
+/**
+ * @brief Root node of the FloatImageViewer, owning the render thread resources of the viewer.
+ */
+class ImageViewerNode : public QSGGeometryNode
+{
+  public:
+    /// GPU-resident textures of the upcoming sequence frames during playback
+    TextureRing textureRing;
+};
+
+/**
+ * @brief Transformation fitting the surface in the item, keeping its aspect ratio.
+ * The vertices of the surface stay in image coordinates: resizing or moving the item only changes this matrix.
+ * @param[in] boundingRect bounding rectangle of the item
+ * @param[in] surfaceSize size of the image the vertices of the surface are expressed in
+ */
+QMatrix4x4 getSurfaceFitMatrix(const QRectF& boundingRect, const QSize& surfaceSize)
+{
+    QMatrix4x4 matrix;
+    if (boundingRect.isEmpty() || surfaceSize.isEmpty())
+        return matrix;
+
+    const double scale = std::min(boundingRect.width() / surfaceSize.width(), boundingRect.height() / surfaceSize.height());
+    const QPointF offset = boundingRect.center() - QPointF(0.5 * scale * surfaceSize.width(), 0.5 * scale * surfaceSize.height());
+    matrix.translate(static_cast<float>(offset.x()), static_cast<float>(offset.y()));
+    matrix.scale(static_cast<float>(scale));
+    return matrix;
+}
+
+/// Identify the image loaded for a request, to share its texture between the viewers
+TextureRegistry::Key getTextureKey(const imgserve::RequestData& request)
+{
+    TextureRegistry::Key key;
+    key.path = request.path;
+    key.downscale = request.downscale;
+    key.lastModified = QFileInfo(QString::fromStdString(request.path)).lastModified().toMSecsSinceEpoch();
+    return key;
+}
+
+/**
+ * @brief Get the texture of an image, shared with the other viewers displaying the same image if its source is known.
+ * @param[in] key source of the image, the texture is not shared if its path is empty
+ * @param[in] image image to display
+ */
+std::shared_ptr<FloatTexture> acquireTexture(TextureRegistry::Key key, const std::shared_ptr<FloatImage>& image)
+{
+    std::shared_ptr<FloatTexture> texture;
+    if (key.path.empty())
+    {
+        texture = std::make_shared<FloatTexture>();
+        std::shared_ptr<FloatImage> srcImage = image;
+        texture->setImage(srcImage);
+    }
+    else
+    {
+        key.width = image->width();
+        key.height = image->height();
+        texture = TextureRegistry::forCurrentContext().acquire(key, image);
+    }
+
+    // Same options for all the viewers: setting them again on a shared texture does not change anything
+    texture->setFiltering(QSGTexture::Nearest);
+    texture->setHorizontalWrapMode(QSGTexture::Repeat);
+    texture->setVerticalWrapMode(QSGTexture::Repeat);
+    return texture;
+}
+
+}  // namespace
+
 FloatImageViewer::FloatImageViewer(QQuickItem* parent)
   : QQuickItem(parent)
 {
@@ -26,9 +116,21 @@ FloatImageViewer::FloatImageViewer(QQuickItem* parent)
     connect(this, &FloatImageViewer::textureSizeChanged, this, &FloatImageViewer::update);
     connect(this, &FloatImageViewer::sourceSizeChanged, this, &FloatImageViewer::update);
     connect(this, &FloatImageViewer::imageChanged, this, &FloatImageViewer::update);
+    connect(this, &FloatImageViewer::imageChanged, this, [this]() { _imageStats.setImage(_image); });
     connect(this, &FloatImageViewer::sourceChanged, this, &FloatImageViewer::reload);
 
     connect(this, &FloatImageViewer::channelModeChanged, this, &FloatImageViewer::update);
+    connect(this, &FloatImageViewer::displayLutChanged, this, &FloatImageViewer::update);
+    connect(this, &FloatImageViewer::diagnosticModeChanged, this, &FloatImageViewer::update);
+    connect(this, &FloatImageViewer::clippingThresholdChanged, this, &FloatImageViewer::update);
+    connect(this, &FloatImageViewer::zebraThresholdChanged, this, &FloatImageViewer::update);
+
+    connect(this, &FloatImageViewer::compareSourceChanged, this, &FloatImageViewer::reloadCompare);
+    connect(this, &FloatImageViewer::compareModeChanged, this, &FloatImageViewer::reloadCompare);
+    connect(this, &FloatImageViewer::wipePositionChanged, this, &FloatImageViewer::update);
+    connect(this, &FloatImageViewer::onionSkinOpacityChanged, this, &FloatImageViewer::update);
+
+    connect(this, &FloatImageViewer::displayRenderStatsChanged, this, &FloatImageViewer::update);
 
     connect(this, &FloatImageViewer::downscaleLevelChanged, this, &FloatImageViewer::reload);
 
@@ -41,11 +143,26 @@ FloatImageViewer::FloatImageViewer(QQuickItem* parent)
 
     connect(&_surface, &Surface::subdivisionsChanged, this, &FloatImageViewer::update);
     connect(&_surface, &Surface::verticesChanged, this, &FloatImageViewer::update);
+    connect(&_surface, &Surface::useStMapChanged, this, &FloatImageViewer::update);
+    connect(&_surface, &Surface::cropFisheyeChanged, this, &FloatImageViewer::isCropFisheyeChanged);
+    connect(&_surface, &Surface::cropFisheyeChanged, this, &FloatImageViewer::update);
+    connect(&_surface, &Surface::stMapChanged, this, &FloatImageViewer::update);
+    connect(&_surface, &Surface::anglesChanged, this, &FloatImageViewer::update);
 
     connect(&_singleImageLoader, &imgserve::SingleImageLoader::requestHandled, this, &FloatImageViewer::reload);
     connect(&_sequenceCache, &imgserve::SequenceCache::requestHandled, this, &FloatImageViewer::reload);
     connect(&_sequenceCache, &imgserve::SequenceCache::contentChanged, this, &FloatImageViewer::reload);
     connect(this, &FloatImageViewer::useSequenceChanged, this, &FloatImageViewer::reload);
+
+    connect(&_singleImageLoader, &imgserve::SingleImageLoader::requestHandled, this, &FloatImageViewer::reloadCompare);
+    connect(&_sequenceCache, &imgserve::SequenceCache::requestHandled, this, &FloatImageViewer::reloadCompare);
+    connect(&_sequenceCache, &imgserve::SequenceCache::contentChanged, this, &FloatImageViewer::reloadCompare);
+    connect(this, &FloatImageViewer::useSequenceChanged, this, &FloatImageViewer::reloadCompare);
+    connect(this, &FloatImageViewer::downscaleLevelChanged, this, &FloatImageViewer::reloadCompare);
+
+    connect(this, &QQuickItem::windowChanged, this, &FloatImageViewer::onWindowChanged);
+    connect(this, &FloatImageViewer::sourceSizeChanged, this, &FloatImageViewer::updateAutoDownscale);
+    connect(this, &FloatImageViewer::useSequenceChanged, this, &FloatImageViewer::updateAutoDownscale);
 }
 
 FloatImageViewer::~FloatImageViewer() {}
@@ -93,17 +210,121 @@ void FloatImageViewer::setMemoryLimit(int memoryLimit) {
     Q_EMIT memoryLimitChanged();
 }
 
+void FloatImageViewer::setDisplayLut(const QUrl& displayLut)
+{
+    if (_displayLut == displayLut)
+        return;
+
+    _displayLut = displayLut;
+
+    // The LUT is parsed once here, applying it is then free for the CPU
+    _lut.reset();
+    if (!_displayLut.isEmpty())
+    {
+        try
+        {
+            _lut = loadCubeLut(_displayLut.toLocalFile().toStdString());
+        }
+        catch (const std::runtime_error& e)
+        {
+            qWarning() << "[QtAliceVision] Failed to load display LUT: " << e.what();
+        }
+    }
+    _lutChanged = true;
+
+    Q_EMIT displayLutChanged();
+}
+
+void FloatImageViewer::setAutoDownscale(bool autoDownscale)
+{
+    if (_autoDownscale == autoDownscale)
+        return;
+
+    _autoDownscale = autoDownscale;
+    Q_EMIT autoDownscaleChanged();
+
+    updateAutoDownscale();
+}
+
+void FloatImageViewer::onWindowChanged(QQuickWindow* win)
+{
+    disconnect(_windowConnection);
+    if (win)
+    {
+        // Zooming is usually done by scaling a parent item, which does not notify its children:
+        // re-evaluate the downscale level before each frame instead (cheap when nothing changed)
+        _windowConnection = connect(win, &QQuickWindow::afterAnimating, this, &FloatImageViewer::updateAutoDownscale);
+    }
+}
+
+void FloatImageViewer::updateAutoDownscale()
+{
+    // The sequence cache ignores the requested downscale, the resolution of its frames is driven by the target size
+    if (!_autoDownscale || _useSequence || !window() || _sourceSize.isEmpty())
+        return;
+
+    // Size of the item on screen, including the scale of all its parents, in physical pixels
+    const QRectF sceneRect = mapRectToScene(boundingRect());
+    const double devicePixelRatio = window()->effectiveDevicePixelRatio();
+    const double displayedWidth = sceneRect.width() * devicePixelRatio;
+    const double displayedHeight = sceneRect.height() * devicePixelRatio;
+    if (displayedWidth <= 0.0 || displayedHeight <= 0.0)
+        return;
+
+    // The image is fitted in the item while keeping its aspect ratio
+    const double screenPixelsPerSourcePixel =
+      std::min(displayedWidth / static_cast<double>(_sourceSize.width()), displayedHeight / static_cast<double>(_sourceSize.height()));
+
+    // Largest power of 2 downscale that still provides at least one image pixel per screen pixel
+    const int level = std::max(0, static_cast<int>(std::floor(std::log2(1.0 / screenPixelsPerSourcePixel))));
+    if (level == _downscaleLevel)
+        return;
+
+    // Keep the current image on screen until the one at the new resolution is available
+    _keepImageOnReload = true;
+    setDownscaleLevel(level);
+    _keepImageOnReload = false;
+}
+
 QVariantList FloatImageViewer::getCachedFrames() const { return _sequenceCache.getCachedFrames(); }
 
 QPointF FloatImageViewer::getRamInfo() const { return _sequenceCache.getRamInfo(); }
 
+void FloatImageViewer::setImage(const std::shared_ptr<FloatImage>& image)
+{
+    // Same pixel data: nothing to upload
+    if (_image == image)
+    {
+        if (image)
+        {
+            ++_skippedUploads;
+            Q_EMIT skippedUploadsChanged();
+        }
+        return;
+    }
+
+    _image = image;
+    ++_imageVersion;
+    Q_EMIT imageChanged();
+}
+
 void FloatImageViewer::reload()
 {
-    if (_clearBeforeLoad)
+    // Request data
+    imgserve::RequestData reqData;
+    if (_source.isValid())
     {
-        _image.reset();
-        _imageChanged = true;
-        Q_EMIT imageChanged();
+        reqData.path = _source.toLocalFile().toUtf8().toStdString();
+        reqData.downscale = 1 << _downscaleLevel;
+    }
+
+    // Reloads are also triggered by the image servers progress: only clear the image when a different one is requested
+    const bool newRequest = reqData.path != _lastRequest.path || reqData.downscale != _lastRequest.downscale;
+    _lastRequest = reqData;
+
+    if (_clearBeforeLoad && newRequest && !_keepImageOnReload)
+    {
+        setImage(nullptr);
     }
 
     _outdated = false;
@@ -114,37 +335,49 @@ void FloatImageViewer::reload()
 
     if (!_source.isValid())
     {
-        _image.reset();
-        _imageChanged = true;
+        setImage(nullptr);
         _surface.clearVertices();
         _surface.verticesChanged();
-        Q_EMIT imageChanged();
         return;
     }
 
     // Send request
-    imgserve::RequestData reqData;
-    reqData.path = _source.toLocalFile().toUtf8().toStdString();
-    reqData.downscale = 1 << _downscaleLevel;
-
     imgserve::ResponseData response = _useSequence ? _sequenceCache.request(reqData) : _singleImageLoader.request(reqData);
 
+    // Images loaded synchronously by the image server are also misses
+    if (newRequest)
+    {
+        _renderStats.addCacheAccess(response.img && response.decodeTime == 0.0);
+    }
+
     if (response.img)
     {
         setLoading(false);
         setStatus(EStatus::NONE);
 
-        _surface.setVerticesChanged(true);
-        _surface.setNeedToUseIntrinsic(true);
-        _image = response.img;
-        _imageChanged = true;
-        Q_EMIT imageChanged();
+        if (response.img != _image)
+        {
+            _surface.setVerticesChanged(true);
+            _surface.setNeedToUseIntrinsic(true);
+            _imageTextureKey = getTextureKey(reqData);
+        }
+        if (response.decodeTime > 0.0 || response.resizeTime > 0.0)
+        {
+            _renderStats.addDecode(response.decodeTime, response.resizeTime);
+        }
+        setImage(response.img);
 
-        _sourceSize = response.dim;
-        Q_EMIT sourceSizeChanged();
+        if (_sourceSize != response.dim)
+        {
+            _sourceSize = response.dim;
+            Q_EMIT sourceSizeChanged();
+        }
 
-        _metadata = response.metadata;
-        Q_EMIT metadataChanged();
+        if (_metadata != response.metadata)
+        {
+            _metadata = response.metadata;
+            Q_EMIT metadataChanged();
+        }
     }
     else if (response.error == imgserve::LoadingStatus::UNDEFINED)
     {
@@ -153,12 +386,12 @@ void FloatImageViewer::reload()
     }
     else if (response.error == imgserve::LoadingStatus::MISSING_FILE)
     {
-        _image.reset();
+        setImage(nullptr);
         setStatus(EStatus::MISSING_FILE);
     }
     else if (response.error == imgserve::LoadingStatus::LOADING_ERROR)
     {
-        _image.reset();
+        setImage(nullptr);
         setStatus(EStatus::LOADING_ERROR);
     }
     else if (_outdated)
@@ -170,10 +403,50 @@ void FloatImageViewer::reload()
     Q_EMIT cachedFramesChanged();
 }
 
+void FloatImageViewer::reloadCompare()
+{
+    // Keep the single image loader responses for both images while comparing
+    _singleImageLoader.setCapacity(_compareMode == ECompareMode::NONE ? 1 : 2);
+
+    std::shared_ptr<FloatImage> compareImage;
+    imgserve::RequestData reqData;
+    if (_compareMode != ECompareMode::NONE && _compareSource.isValid())
+    {
+        reqData.path = _compareSource.toLocalFile().toUtf8().toStdString();
+        reqData.downscale = 1 << _downscaleLevel;
+
+        // Share the image server of the image: the sequence cache if the compared image is part of the sequence
+        const bool useSequence = _useSequence && _sequenceCache.contains(reqData.path);
+        imgserve::ResponseData response = useSequence ? _sequenceCache.request(reqData) : _singleImageLoader.request(reqData);
+
+        if (!response.img && response.error == imgserve::LoadingStatus::UNDEFINED)
+        {
+            // Still loading: keep the current compared image until the new one is available
+            return;
+        }
+        compareImage = response.img;
+    }
+
+    if (compareImage == _compareImage)
+    {
+        update();
+        return;
+    }
+
+    _compareImage = compareImage;
+    _compareTextureKey = getTextureKey(reqData);
+    ++_compareImageVersion;
+    update();
+}
+
 void FloatImageViewer::playback(bool active)
 {
     // Turn off interactive prefetching when playback is ON
     _sequenceCache.setInteractivePrefetching(!active);
+
+    // Fill or release the flipbook textures
+    _playback = active;
+    update();
 }
 
 QVector4D FloatImageViewer::pixelValueAt(int x, int y)
@@ -194,20 +467,171 @@ QVector4D FloatImageViewer::pixelValueAt(int x, int y)
     return QVector4D(color(0), color(1), color(2), color(3));
 }
 
+QByteArray FloatImageViewer::pixelValuesInRect(int x, int y, int width, int height)
+{
+    // Computed on 64 bits: the region comes from QML and may be arbitrarily large
+    const qint64 regionWidth = std::max(0, width);
+    const qint64 regionHeight = std::max(0, height);
+    if (regionWidth * regionHeight > maxProbedPixels)
+    {
+        qWarning() << "[QtAliceVision] FloatImageViewer::pixelValuesInRect: region of" << regionWidth << "x" << regionHeight << "pixels is too large";
+        return QByteArray();
+    }
+    QByteArray values(static_cast<int>(regionWidth * regionHeight * 4 * static_cast<qint64>(sizeof(float))), 0);
+
+    // Keep a reference on the image: it may be replaced while reading it
+    const std::shared_ptr<FloatImage> image = _image;
+    if (!image)
+        return values;
+
+    // Clip the region to the image
+    const qint64 xBegin = std::max<qint64>(0, x);
+    const qint64 yBegin = std::max<qint64>(0, y);
+    const qint64 xEnd = std::min<qint64>(image->width(), x + regionWidth);
+    const qint64 yEnd = std::min<qint64>(image->height(), y + regionHeight);
+    if (xBegin >= xEnd || yBegin >= yEnd)
+        return values;
+
+    // Pixels are stored contiguously as RGBA floats: copy whole row segments at once
+    const std::size_t rowSize = static_cast<std::size_t>(xEnd - xBegin) * sizeof(aliceVision::image::RGBAfColor);
+    float* dst = reinterpret_cast<float*>(values.data());
+    for (qint64 row = yBegin; row < yEnd; ++row)
+    {
+        const std::size_t dstOffset = static_cast<std::size_t>((row - y) * regionWidth + (xBegin - x)) * 4;
+        std::memcpy(dst + dstOffset, &(*image)(static_cast<int>(row), static_cast<int>(xBegin)), rowSize);
+    }
+
+    return values;
+}
+
+QByteArray FloatImageViewer::pixelValuesAlongLine(int x0, int y0, int x1, int y1)
+{
+    // Computed on 64 bits: the end points come from QML and may be arbitrarily far apart
+    const qint64 dx = static_cast<qint64>(x1) - x0;
+    const qint64 dy = static_cast<qint64>(y1) - y0;
+    const qint64 nbSamples = std::max(std::abs(dx), std::abs(dy)) + 1;
+    if (nbSamples > maxProbedPixels)
+    {
+        qWarning() << "[QtAliceVision] FloatImageViewer::pixelValuesAlongLine: line of" << nbSamples << "samples is too long";
+        return QByteArray();
+    }
+    QByteArray values(static_cast<int>(nbSamples * 4 * static_cast<qint64>(sizeof(float))), 0);
+
+    const std::shared_ptr<FloatImage> image = _image;
+    if (!image)
+        return values;
+
+    float* dst = reinterpret_cast<float*>(values.data());
+    for (qint64 i = 0; i < nbSamples; ++i)
+    {
+        const double t = nbSamples > 1 ? static_cast<double>(i) / static_cast<double>(nbSamples - 1) : 0.0;
+        const qint64 x = std::llround(x0 + t * static_cast<double>(dx));
+        const qint64 y = std::llround(y0 + t * static_cast<double>(dy));
+        if (x < 0 || x >= image->width() || y < 0 || y >= image->height())
+            continue;
+
+        std::memcpy(dst + static_cast<std::size_t>(i) * 4, &(*image)(static_cast<int>(y), static_cast<int>(x)), sizeof(aliceVision::image::RGBAfColor));
+    }
+
+    return values;
+}
+
+QVariantMap FloatImageViewer::regionStatistics(int x, int y, int width, int height)
+{
+    QVector4D average(0.f, 0.f, 0.f, 0.f);
+    QVector4D minimum(0.f, 0.f, 0.f, 0.f);
+    QVector4D maximum(0.f, 0.f, 0.f, 0.f);
+    qint64 count = 0;
+
+    const std::shared_ptr<FloatImage> image = _image;
+    if (image)
+    {
+        // Clip the region to the image, on 64 bits to not overflow with arbitrarily large regions
+        const int xBegin = std::max(0, x);
+        const int yBegin = std::max(0, y);
+        const int xEnd = static_cast<int>(std::min<qint64>(image->width(), static_cast<qint64>(x) + std::max(0, width)));
+        const int yEnd = static_cast<int>(std::min<qint64>(image->height(), static_cast<qint64>(y) + std::max(0, height)));
+
+        count = xBegin < xEnd && yBegin < yEnd ? static_cast<qint64>(xEnd - xBegin) * (yEnd - yBegin) : 0;
+        if (count > maxProbedPixels)
+        {
+            qWarning() << "[QtAliceVision] FloatImageViewer::regionStatistics: region of" << count << "pixels is too large";
+            return QVariantMap();
+        }
+
+        if (count > 0)
+        {
+            // Non-finite values are skipped, as in ImageStats
+            double sums[4] = {0.0, 0.0, 0.0, 0.0};
+            qint64 counts[4] = {0, 0, 0, 0};
+            float minValues[4];
+            float maxValues[4];
+            std::fill(minValues, minValues + 4, std::numeric_limits<float>::max());
+            std::fill(maxValues, maxValues + 4, std::numeric_limits<float>::lowest());
+
+            for (int row = yBegin; row < yEnd; ++row)
+            {
+                const float* values = reinterpret_cast<const float*>(&(*image)(row, xBegin));
+                for (int col = 0; col < xEnd - xBegin; ++col)
+                {
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        const float value = values[col * 4 + c];
+                        if (!std::isfinite(value))
+                            continue;
+                        sums[c] += static_cast<double>(value);
+                        minValues[c] = std::min(minValues[c], value);
+                        maxValues[c] = std::max(maxValues[c], value);
+                        ++counts[c];
+                    }
+                }
+            }
+
+            for (int c = 0; c < 4; ++c)
+            {
+                if (counts[c] == 0)
+                    continue;
+                average[c] = static_cast<float>(sums[c] / static_cast<double>(counts[c]));
+                minimum[c] = minValues[c];
+                maximum[c] = maxValues[c];
+            }
+        }
+    }
+
+    QVariantMap stats;
+    stats["average"] = average;
+    stats["minimum"] = minimum;
+    stats["maximum"] = maximum;
+    stats["count"] = count;
+    return stats;
+}
+
 QSGNode* FloatImageViewer::updatePaintNode(QSGNode* oldNode, QQuickItem::UpdatePaintNodeData* data)
 {
     (void)data;  // Fix "unused parameter" warnings; should be replaced by [[maybe_unused]] when C++17 is supported
+    const auto tSync = RenderStats::Clock::now();
     QVector4D channelOrder(0.f, 1.f, 2.f, 3.f);
 
-    QSGGeometryNode* root = static_cast<QSGGeometryNode*>(oldNode);
+    // The image node is placed under a transform node fitting it in the item,
+    // the render stats overlay is its sibling so that it is drawn in item coordinates
+    QSGNode* itemNode = oldNode;
+    QSGTransformNode* transformNode = itemNode ? static_cast<QSGTransformNode*>(itemNode->firstChild()) : nullptr;
+    ImageViewerNode* root = transformNode ? static_cast<ImageViewerNode*>(transformNode->firstChild()) : nullptr;
     QSGSimpleMaterial<ShaderData>* material = nullptr;
 
     QSGGeometry* geometryLine = nullptr;
 
+    const bool newRoot = !root;
     if (!root)
     {
-        root = new QSGGeometryNode;
-        auto geometry = new QSGGeometry(QSGGeometry::defaultAttributes_TexturedPoint2D(), _surface.vertexCount(), _surface.indexCount());
+        itemNode = new QSGNode;
+        transformNode = new QSGTransformNode;
+        itemNode->appendChildNode(transformNode);
+        root = new ImageViewerNode;
+        transformNode->appendChildNode(root);
+        // 32-bit indices: high subdivision counts have more vertices than 16-bit indices can address
+        auto geometry = new QSGGeometry(
+          QSGGeometry::defaultAttributes_TexturedPoint2D(), _surface.geometryVertexCount(), _surface.geometryIndexCount(), QSGGeometry::UnsignedIntType);
         geometry->setDrawingMode(GL_TRIANGLES);
         geometry->setIndexDataPattern(QSGGeometry::StaticPattern);
         geometry->setVertexDataPattern(QSGGeometry::StaticPattern);
@@ -217,6 +641,8 @@ QSGNode* FloatImageViewer::updatePaintNode(QSGNode* oldNode, QQuickItem::UpdateP
         material = ImageViewerShader::createMaterial();
         root->setMaterial(material);
         root->setFlags(QSGNode::OwnsMaterial);
+        // New material: the display LUT needs to be set again
+        _lutChanged = true;
         {
             /* Geometry and Material for the Grid */
             auto node = new QSGGeometryNode;
@@ -234,14 +660,28 @@ QSGNode* FloatImageViewer::updatePaintNode(QSGNode* oldNode, QQuickItem::UpdateP
                 node->setFlags(QSGNode::OwnsMaterial);
             }
             root->appendChildNode(node);
+            _surface.setGridChanged(true);
         }
+        // The new geometry is empty: fill it with the vertices of the surface
+        _surface.setVerticesChanged(true);
+        // Render stats overlay, drawn over the image and the grid in item coordinates
+        itemNode->appendChildNode(new QSGNode);
     }
     else
     {
         _createRoot = false;
         material = static_cast<QSGSimpleMaterial<ShaderData>*>(root->material());
 
-        QSGGeometryNode* rootGrid = static_cast<QSGGeometryNode*>(oldNode->childAtIndex(0));
+        // Textures are uploaded when bound during the rendering of the previous frame
+        for (const auto& texture : {material->state()->texture, material->state()->textureB})
+        {
+            auto floatTexture = std::dynamic_pointer_cast<FloatTexture>(texture);
+            const double uploadTime = floatTexture ? floatTexture->takeUploadTime() : 0.0;
+            if (uploadTime > 0.0)
+                _renderStats.addUpload(uploadTime);
+        }
+
+        QSGGeometryNode* rootGrid = static_cast<QSGGeometryNode*>(root->childAtIndex(0));
         auto mat = static_cast<QSGFlatColorMaterial*>(rootGrid->activeMaterial());
         mat->setColor(_surface.getGridColor());
         geometryLine = rootGrid->geometry();
@@ -259,9 +699,10 @@ QSGNode* FloatImageViewer::updatePaintNode(QSGNode* oldNode, QQuickItem::UpdateP
         // Re size root
         if (root)
         {
-            root->geometry()->allocate(_surface.vertexCount(), _surface.indexCount());
+            root->geometry()->allocate(_surface.geometryVertexCount(), _surface.geometryIndexCount());
             root->markDirty(QSGNode::DirtyGeometry);
         }
+        _surface.setHasSubdivisionsChanged(false);
     }
 
     // enable Blending flag for transparency for RGBA
@@ -288,84 +729,141 @@ QSGNode* FloatImageViewer::updatePaintNode(QSGNode* oldNode, QQuickItem::UpdateP
             break;
     }
 
-    bool updateGeometry = false;
+    // Diagnostics are computed on the RGB channels, only keep the alpha selection
+    if (_diagnosticMode != EDiagnosticMode::NONE)
+    {
+        channelOrder = QVector4D(0.f, 1.f, 2.f, channelOrder.w());
+    }
+
     material->state()->gamma = _gamma;
     material->state()->gain = _gain;
     material->state()->channelOrder = channelOrder;
+    material->state()->diagnosticMode = static_cast<float>(static_cast<int>(_diagnosticMode));
+    material->state()->diagnosticThreshold = _diagnosticMode == EDiagnosticMode::ZEBRA ? _zebraThreshold : _clippingThreshold;
+
+    // Panorama rotation is applied in the vertex shader: changing the angles does not modify the vertices
+    const float panorama = _surface.isPanoramaViewerEnabled() ? 1.f : 0.f;
+    if (panorama > 0.f || material->state()->panorama > 0.f)
+    {
+        const Eigen::Matrix3f rotation = _surface.getPanoramaRotation().cast<float>();
+        const Eigen::Matrix<float, 3, 3, Eigen::RowMajor> rowMajorRotation = rotation;
+        material->state()->panorama = panorama;
+        material->state()->panoramaRotation = QMatrix3x3(rowMajorRotation.data());
+        material->state()->panoramaSize = QVector2D(static_cast<float>(_surface.getPanoramaSize().width()),
+                                                    static_cast<float>(_surface.getPanoramaSize().height()));
+        const aliceVision::Vec3& center = _surface.getPanoramaCenter();
+        material->state()->panoramaCenter = QVector4D(static_cast<float>(center.x()),
+                                                      static_cast<float>(center.y()),
+                                                      static_cast<float>(center.z()),
+                                                      static_cast<float>(_surface.getPanoramaRadius()));
+        root->markDirty(QSGNode::DirtyMaterial);
+    }
 
-    if (_imageChanged)
+    if (_lutChanged)
+    {
+        _lutChanged = false;
+        if (_lut)
+        {
+            auto lutTexture = std::make_unique<LutTexture>();
+            lutTexture->setLut(_lut);
+            material->state()->lut = std::move(lutTexture);
+            material->state()->lutSize = static_cast<float>(_lut->size);
+            material->state()->lutDomainMin = _lut->domainMin;
+            const QVector3D domainRange = _lut->domainMax - _lut->domainMin;
+            material->state()->lutInvDomainRange = QVector3D(1.f / domainRange.x(), 1.f / domainRange.y(), 1.f / domainRange.z());
+        }
+        else
+        {
+            material->state()->lut.reset();
+            material->state()->lutSize = 0.f;
+        }
+        root->markDirty(QSGNode::DirtyMaterial);
+    }
+
+    // Flipbook: during playback, keep the upcoming frames of the sequence resident on the GPU
+    if (_playback && _flipbookSize > 0 && _useSequence && !_lastRequest.path.empty())
+    {
+        root->textureRing.update(_sequenceCache.getCachedImages(_lastRequest.path, _flipbookSize), maxFlipbookUploadsPerFrame);
+        for (const double uploadTime : root->textureRing.takeUploadTimes())
+            _renderStats.addUpload(uploadTime);
+    }
+    else
+    {
+        root->textureRing.clear();
+    }
+
+    // Only upload a texture when the pixel data actually changed
+    if (newRoot || _textureImageVersion != _imageVersion)
     {
         QSize newTextureSize;
-        auto texture = std::make_unique<FloatTexture>();
+        // Swap in the texture of the flipbook if the frame is already resident
+        std::shared_ptr<FloatTexture> texture = _image ? root->textureRing.get(_image) : nullptr;
+        if (!texture)
+        {
+            texture = _image ? acquireTexture(_imageTextureKey, _image) : std::make_shared<FloatTexture>();
+        }
         if (_image)
         {
-            texture->setImage(_image);
-            texture->setFiltering(QSGTexture::Nearest);
-            texture->setHorizontalWrapMode(QSGTexture::Repeat);
-            texture->setVerticalWrapMode(QSGTexture::Repeat);
             newTextureSize = texture->textureSize();
-
-            // Crop the image to only display what is inside the fisheye circle
-            const aliceVision::camera::Equidistant* intrinsicEquidistant = _surface.getIntrinsicEquidistant();
-            if (_cropFisheye && intrinsicEquidistant)
-            {
-                const aliceVision::Vec3 fisheyeCircleParams(
-                  intrinsicEquidistant->getCircleCenterX(), intrinsicEquidistant->getCircleCenterY(), intrinsicEquidistant->getCircleRadius());
-
-                const double width = _image->width() * pow(2.0, _downscaleLevel);
-                const double height = _image->height() * pow(2.0, _downscaleLevel);
-                const double aspectRatio = (width > height) ? width / height : height / width;
-
-                const double radiusInPercentage = (fisheyeCircleParams.z() / ((width > height) ? height : width)) * 2.0;
-
-                // Radius is converted in uv coordinates (0, 0.5)
-                const float radius = 0.5f * static_cast<float>(radiusInPercentage);
-
-                material->state()->fisheyeCircleCoord =
-                  QVector2D(static_cast<float>(fisheyeCircleParams.x() / width), static_cast<float>(fisheyeCircleParams.y() / height));
-                material->state()->fisheyeCircleRadius = radius;
-                material->state()->aspectRatio = static_cast<float>(aspectRatio);
-            }
-            else
-            {
-                material->state()->fisheyeCircleRadius = 0.0;
-            }
         }
-        material->state()->texture = std::move(texture);
+        material->state()->texture = texture;
 
-        _imageChanged = false;
+        _textureImageVersion = _imageVersion;
+        root->markDirty(QSGNode::DirtyMaterial);
 
         if (_textureSize != newTextureSize)
         {
             _textureSize = newTextureSize;
-            updateGeometry = true;
             Q_EMIT textureSizeChanged();
         }
     }
 
-    const auto newBoundingRect = boundingRect();
-    if (updateGeometry || _boundingRect != newBoundingRect)
+    // Per pixel undistortion through the ST-map computed by the surface
+    const std::shared_ptr<const StMap> stMap = _surface.isStMapEnabled() ? _surface.getStMap() : nullptr;
+    const std::shared_ptr<const StMap> currentStMap = material->state()->stMap ? material->state()->stMap->stMap() : nullptr;
+    if (stMap != currentStMap)
     {
-        _boundingRect = newBoundingRect;
-
-        const double windowRatio = _boundingRect.width() / _boundingRect.height();
-        const float textureRatio = static_cast<float>(_textureSize.width()) / static_cast<float>(_textureSize.height());
-        QRectF geometryRect = _boundingRect;
-        if (windowRatio > textureRatio)
+        if (stMap)
         {
-            geometryRect.setWidth(geometryRect.height() * textureRatio);
+            auto stMapTexture = std::make_unique<StMapTexture>();
+            stMapTexture->setStMap(stMap);
+            material->state()->stMap = std::move(stMapTexture);
         }
         else
         {
-            geometryRect.setHeight(geometryRect.width() / textureRatio);
+            material->state()->stMap.reset();
         }
-        geometryRect.moveCenter(_boundingRect.center());
+        root->markDirty(QSGNode::DirtyMaterial);
+    }
 
-        static const int MARGIN = 0;
-        geometryRect = geometryRect.adjusted(MARGIN, MARGIN, -MARGIN, -MARGIN);
+    // A/B comparison, sharing the geometry and the draw call of the image
+    if (newRoot || _textureCompareImageVersion != _compareImageVersion)
+    {
+        std::shared_ptr<FloatTexture> textureB;
+        if (_compareImage)
+        {
+            textureB = acquireTexture(_compareTextureKey, _compareImage);
+        }
+        material->state()->textureB = textureB;
+        _textureCompareImageVersion = _compareImageVersion;
+        root->markDirty(QSGNode::DirtyMaterial);
+    }
+    material->state()->compareMode = static_cast<float>(static_cast<int>(_compareMode));
+    material->state()->compareValue = _compareMode == ECompareMode::WIPE ? _wipePosition : _onionSkinOpacity;
+    if (_compareMode != ECompareMode::NONE && _compareMode != ECompareMode::DIFFERENCE)
+    {
+        // Parts of the compared image may be transparent
+        material->setFlag(QSGMaterial::Blending, true);
+    }
 
-        QSGGeometry::updateTexturedRectGeometry(root->geometry(), geometryRect, QRectF(0, 0, 1, 1));
-        root->markDirty(QSGNode::DirtyGeometry);
+    // Only the matrix is updated when the item is resized or moved, the vertices of the surface are left untouched.
+    // The panorama is drawn in panorama coordinates, shared by all the viewers of its images.
+    const QMatrix4x4 fitMatrix =
+      _surface.isPanoramaViewerEnabled() ? QMatrix4x4() : getSurfaceFitMatrix(boundingRect(), _sourceSize.isEmpty() ? _textureSize : _sourceSize);
+    if (transformNode->matrix() != fitMatrix)
+    {
+        transformNode->setMatrix(fitMatrix);
+        transformNode->markDirty(QSGNode::DirtyMatrix);
     }
 
     /*
@@ -376,7 +874,10 @@ QSGNode* FloatImageViewer::updatePaintNode(QSGNode* oldNode, QQuickItem::UpdateP
         updatePaintSurface(root, material, geometryLine);
     }
 
-    return root;
+    _renderStats.addFrame(RenderStats::elapsedMs(tSync));
+    updatePaintRenderStats(itemNode->childAtIndex(1));
+
+    return itemNode;
 }
 
 void FloatImageViewer::updatePaintSurface(QSGGeometryNode* root, QSGSimpleMaterial<ShaderData>* material, QSGGeometry* geometryLine)
@@ -396,9 +897,10 @@ void FloatImageViewer::updatePaintSurface(QSGGeometryNode* root, QSGSimpleMateri
     {
         // Retrieve Vertices and Index Data
         QSGGeometry::TexturedPoint2D* vertices = root->geometry()->vertexDataAsTexturedPoint2D();
-        quint16* indices = root->geometry()->indexDataAsUShort();
+        quint32* indices = root->geometry()->indexDataAsUInt();
 
         // Update surface
+        const auto tGeometry = RenderStats::Clock::now();
         const QSize surfaceSize = _surface.isPanoramaViewerEnabled() ? _textureSize : _sourceSize;
         _surface.update(vertices, indices, surfaceSize, _downscaleLevel);
 
@@ -408,12 +910,96 @@ void FloatImageViewer::updatePaintSurface(QSGGeometryNode* root, QSGSimpleMateri
 
         // Fill the Surface vertices array
         _surface.fillVertices(vertices);
+        _renderStats.addGeometry(RenderStats::elapsedMs(tGeometry));
     }
 
+    // Images containing a pole of the panorama drop the cells crossing the cut of their unwrapping, which depends on the rotation
+    if (_surface.updatePanoramaIndices(root->geometry()->indexDataAsUInt()))
+    {
+        root->geometry()->markIndexDataDirty();
+        root->markDirty(QSGNode::DirtyGeometry);
+    }
+
+    // Crop the image to only display what is inside the fisheye circle.
+    // Nothing is done per fragment once the surface is fitted to the circle, the pixels outside of it are not even rasterized.
+    const aliceVision::camera::Equidistant* intrinsicEquidistant = _surface.getIntrinsicEquidistant();
+    float fisheyeCircleRadius = 0.f;
+    if (_image && _surface.getCropFisheye() && intrinsicEquidistant && !_surface.isMeshCircular())
+    {
+        const aliceVision::Vec3 fisheyeCircleParams(
+          intrinsicEquidistant->getCircleCenterX(), intrinsicEquidistant->getCircleCenterY(), intrinsicEquidistant->getCircleRadius());
+
+        const double width = _image->width() * pow(2.0, _downscaleLevel);
+        const double height = _image->height() * pow(2.0, _downscaleLevel);
+        const double aspectRatio = (width > height) ? width / height : height / width;
+
+        const double radiusInPercentage = (fisheyeCircleParams.z() / ((width > height) ? height : width)) * 2.0;
+
+        // Radius is converted in uv coordinates (0, 0.5)
+        fisheyeCircleRadius = 0.5f * static_cast<float>(radiusInPercentage);
+
+        material->state()->fisheyeCircleCoord =
+          QVector2D(static_cast<float>(fisheyeCircleParams.x() / width), static_cast<float>(fisheyeCircleParams.y() / height));
+        material->state()->aspectRatio = static_cast<float>(aspectRatio);
+    }
+    if (material->state()->fisheyeCircleRadius != fisheyeCircleRadius)
+    {
+        material->state()->fisheyeCircleRadius = fisheyeCircleRadius;
+        root->markDirty(QSGNode::DirtyMaterial);
+    }
+
+    // Only rebuild the grid lines when the vertices or the grid settings have changed
+    if (!_surface.hasGridChanged())
+        return;
+
     // Draw the grid if Distortion Viewer is enabled and Grid Mode is enabled
     _surface.getDisplayGrid() ? _surface.computeGrid(geometryLine) : _surface.removeGrid(geometryLine);
+    _surface.setGridChanged(false);
 
+    geometryLine->markVertexDataDirty();
     root->childAtIndex(0)->markDirty(QSGNode::DirtyGeometry | QSGNode::DirtyMaterial);
 }
 
+void FloatImageViewer::updatePaintRenderStats(QSGNode* overlay)
+{
+    if (!_displayRenderStats)
+    {
+        _renderStatsPainter.clearLayer(overlay, "renderStatsBackground");
+        _renderStatsPainter.clearLayer(overlay, "renderStatsFrames");
+        _renderStatsPainter.clearLayer(overlay, "renderStatsHitches");
+        _renderStatsPainter.clearLayer(overlay, "renderStatsBudget");
+        return;
+    }
+
+    const double graphWidth = 240.0;
+    const double graphHeight = 60.0;
+    const QPointF origin(boundingRect().left() + 8.0, boundingRect().top() + 8.0);
+    const double bottom = origin.y() + graphHeight;
+
+    auto appendRect = [](std::vector<QPointF>& points, double x0, double y0, double x1, double y1) {
+        points.insert(points.end(), {QPointF(x0, y0), QPointF(x1, y0), QPointF(x1, y1), QPointF(x0, y0), QPointF(x1, y1), QPointF(x0, y1)});
+    };
+
+    std::vector<QPointF> background;
+    appendRect(background, origin.x(), origin.y(), origin.x() + graphWidth, bottom);
+    _renderStatsPainter.drawTriangles(overlay, "renderStatsBackground", background, QColor(0, 0, 0, 160));
+
+    // One bar per frame, frames over budget are highlighted
+    const std::vector<double> frameTimes = _renderStats.frameTimeHistory();
+    std::vector<QPointF> frames;
+    std::vector<QPointF> hitches;
+    const double barWidth = graphWidth / static_cast<double>(RenderStats::historySize);
+    for (std::size_t i = 0; i < frameTimes.size(); ++i)
+    {
+        const double x = origin.x() + static_cast<double>(i) * barWidth;
+        const double barHeight = std::min(frameTimes[i], renderStatsGraphMaxTime) / renderStatsGraphMaxTime * graphHeight;
+        appendRect(frameTimes[i] > renderStatsFrameBudget ? hitches : frames, x, bottom - barHeight, x + barWidth, bottom);
+    }
+    _renderStatsPainter.drawTriangles(overlay, "renderStatsFrames", frames, QColor(80, 200, 80));
+    _renderStatsPainter.drawTriangles(overlay, "renderStatsHitches", hitches, QColor(230, 60, 60));
+
+    const double budgetY = bottom - renderStatsFrameBudget / renderStatsGraphMaxTime * graphHeight;
+    _renderStatsPainter.drawLines(overlay, "renderStatsBudget", {QPointF(origin.x(), budgetY), QPointF(origin.x() + graphWidth, budgetY)}, QColor(255, 255, 255, 200), 1.f);
+}
+
 }  // namespace qtAliceVision
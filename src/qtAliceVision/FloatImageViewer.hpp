@@ -1,10 +1,15 @@
 #pragma once
 
 #include "FloatTexture.hpp"
+#include "ImageStats.hpp"
+#include "Painter.hpp"
+#include "RenderStats.hpp"
 #include "Surface.hpp"
 #include "ShaderImageViewer.hpp"
 #include "SequenceCache.hpp"
 #include "SingleImageLoader.hpp"
+#include "TextureRegistry.hpp"
+#include "TextureRing.hpp"
 
 #include <aliceVision/image/all.hpp>
 
@@ -14,6 +19,7 @@
 #include <QSGSimpleMaterial>
 #include <QVariant>
 #include <QVector4D>
+#include <QByteArray>
 #include <QList>
 
 #include <memory>
@@ -47,12 +53,36 @@ class FloatImageViewer : public QQuickItem
 
     Q_PROPERTY(EChannelMode channelMode MEMBER _channelMode NOTIFY channelModeChanged)
 
+    Q_PROPERTY(EDiagnosticMode diagnosticMode MEMBER _diagnosticMode NOTIFY diagnosticModeChanged)
+
+    Q_PROPERTY(float clippingThreshold MEMBER _clippingThreshold NOTIFY clippingThresholdChanged)
+
+    Q_PROPERTY(float zebraThreshold MEMBER _zebraThreshold NOTIFY zebraThresholdChanged)
+
+    Q_PROPERTY(QUrl displayLut READ getDisplayLut WRITE setDisplayLut NOTIFY displayLutChanged)
+
+    Q_PROPERTY(QUrl compareSource MEMBER _compareSource NOTIFY compareSourceChanged)
+
+    Q_PROPERTY(ECompareMode compareMode MEMBER _compareMode NOTIFY compareModeChanged)
+
+    Q_PROPERTY(float wipePosition MEMBER _wipePosition NOTIFY wipePositionChanged)
+
+    Q_PROPERTY(float onionSkinOpacity MEMBER _onionSkinOpacity NOTIFY onionSkinOpacityChanged)
+
     Q_PROPERTY(QVariantMap metadata READ metadata NOTIFY metadataChanged)
 
     Q_PROPERTY(int downscaleLevel READ getDownscaleLevel WRITE setDownscaleLevel NOTIFY downscaleLevelChanged)
 
+    Q_PROPERTY(bool autoDownscale READ getAutoDownscale WRITE setAutoDownscale NOTIFY autoDownscaleChanged)
+
     Q_PROPERTY(Surface* surface READ getSurfacePtr NOTIFY surfaceChanged)
 
+    Q_PROPERTY(qtAliceVision::ImageStats* imageStats READ getImageStatsPtr CONSTANT)
+
+    Q_PROPERTY(qtAliceVision::RenderStats* renderStats READ getRenderStatsPtr CONSTANT)
+
+    Q_PROPERTY(bool displayRenderStats MEMBER _displayRenderStats NOTIFY displayRenderStatsChanged)
+
     Q_PROPERTY(bool cropFisheye READ getCropFisheye WRITE setCropFisheye NOTIFY isCropFisheyeChanged)
 
     Q_PROPERTY(QVariantList sequence WRITE setSequence NOTIFY sequenceChanged)
@@ -69,6 +99,10 @@ class FloatImageViewer : public QQuickItem
 
     Q_PROPERTY(QPointF ramInfo READ getRamInfo NOTIFY cachedFramesChanged)
 
+    Q_PROPERTY(int flipbookSize MEMBER _flipbookSize NOTIFY flipbookSizeChanged)
+
+    Q_PROPERTY(int skippedUploads READ getSkippedUploads NOTIFY skippedUploadsChanged)
+
   public:
     explicit FloatImageViewer(QQuickItem* parent = nullptr);
     ~FloatImageViewer() override;
@@ -95,6 +129,9 @@ class FloatImageViewer : public QQuickItem
 
     const QVariantMap& metadata() const { return _metadata; }
 
+    /// Number of times an image server delivered the image already displayed, so that no texture upload was needed
+    int getSkippedUploads() const { return _skippedUploads; }
+
     int getDownscaleLevel() const { return _downscaleLevel; }
     void setDownscaleLevel(int level)
     {
@@ -105,6 +142,9 @@ class FloatImageViewer : public QQuickItem
         Q_EMIT downscaleLevelChanged();
     }
 
+    bool getAutoDownscale() const { return _autoDownscale; }
+    void setAutoDownscale(bool autoDownscale);
+
     enum class EChannelMode : quint8
     {
         RGBA,
@@ -116,8 +156,33 @@ class FloatImageViewer : public QQuickItem
     };
     Q_ENUM(EChannelMode)
 
-    bool getCropFisheye() const { return _cropFisheye; }
-    void setCropFisheye(bool cropFisheye) { _cropFisheye = cropFisheye; }
+    /// Exposure diagnostic displayed instead of (false color) or over (clipping, zebra) the image
+    enum class EDiagnosticMode : quint8
+    {
+        NONE,         // only display the image
+        FALSE_COLOR,  // luminance color-coded in stops around middle grey
+        CLIPPING,     // pixels above clippingThreshold in red, pixels at or below 0 in blue
+        ZEBRA         // stripes over the pixels above zebraThreshold
+    };
+    Q_ENUM(EDiagnosticMode)
+
+    /// Display mode of the compared image (compareSource) with respect to the image (source)
+    enum class ECompareMode : quint8
+    {
+        NONE,        // only display the image
+        WIPE,        // image on the left of wipePosition, compared image on the right
+        DIFFERENCE,  // absolute difference between both images
+        ONION_SKIN   // compared image blended over the image with onionSkinOpacity
+    };
+    Q_ENUM(ECompareMode)
+
+    /// 3D LUT (.cube file) applied in the shader as display transform, the default 2.2 gamma is used if empty
+    const QUrl& getDisplayLut() const { return _displayLut; }
+    void setDisplayLut(const QUrl& displayLut);
+
+    /// The surface is fitted to the fisheye circle when possible, otherwise the image is cropped in the shader
+    bool getCropFisheye() const { return _surface.getCropFisheye(); }
+    void setCropFisheye(bool cropFisheye) { _surface.setCropFisheye(cropFisheye); }
 
     Q_SIGNAL void isCropFisheyeChanged();
 
@@ -130,9 +195,18 @@ class FloatImageViewer : public QQuickItem
     Q_SIGNAL void textureSizeChanged();
     Q_SIGNAL void sourceSizeChanged();
     Q_SIGNAL void channelModeChanged();
+    Q_SIGNAL void diagnosticModeChanged();
+    Q_SIGNAL void clippingThresholdChanged();
+    Q_SIGNAL void zebraThresholdChanged();
+    Q_SIGNAL void displayLutChanged();
+    Q_SIGNAL void compareSourceChanged();
+    Q_SIGNAL void compareModeChanged();
+    Q_SIGNAL void wipePositionChanged();
+    Q_SIGNAL void onionSkinOpacityChanged();
     Q_SIGNAL void imageChanged();
     Q_SIGNAL void metadataChanged();
     Q_SIGNAL void downscaleLevelChanged();
+    Q_SIGNAL void autoDownscaleChanged();
     Q_SIGNAL void surfaceChanged();
     Q_SIGNAL void canBeHoveredChanged();
     Q_SIGNAL void sfmRequiredChanged();
@@ -143,13 +217,43 @@ class FloatImageViewer : public QQuickItem
     Q_SIGNAL void useSequenceChanged();
     Q_SIGNAL void fetchingSequenceChanged();
     Q_SIGNAL void memoryLimitChanged();
+    Q_SIGNAL void flipbookSizeChanged();
+    Q_SIGNAL void skippedUploadsChanged();
+    Q_SIGNAL void displayRenderStatsChanged();
 
     // Q_INVOKABLE
     Q_INVOKABLE QVector4D pixelValueAt(int x, int y);
+
+    /**
+     * @brief Read the pixels of a rectangular region of the image.
+     * @return RGBA float values stored row by row (exposed as an ArrayBuffer in QML, to be read through a Float32Array),
+     *         pixels outside of the image are set to 0, empty if the region has more than 4096x4096 pixels
+     */
+    Q_INVOKABLE QByteArray pixelValuesInRect(int x, int y, int width, int height);
+
+    /**
+     * @brief Read the pixels along a line segment of the image, from (x0, y0) to (x1, y1) included.
+     * @return RGBA float values of max(|x1 - x0|, |y1 - y0|) + 1 evenly spaced samples,
+     *         samples outside of the image are set to 0, empty if there are more than 4096x4096 samples
+     */
+    Q_INVOKABLE QByteArray pixelValuesAlongLine(int x0, int y0, int x1, int y1);
+
+    /**
+     * @brief Compute the per-channel average, minimum and maximum over a rectangular region of the image.
+     * Non-finite values are skipped, as in ImageStats.
+     * @return a map with the "average", "minimum" and "maximum" QVector4D values
+     *         and the "count" of pixels of the region that are inside the image,
+     *         empty if more than 4096x4096 pixels of the region are inside the image
+     */
+    Q_INVOKABLE QVariantMap regionStatistics(int x, int y, int width, int height);
     Q_INVOKABLE void playback(bool active);
 
     Surface* getSurfacePtr() { return &_surface; }
 
+    ImageStats* getImageStatsPtr() { return &_imageStats; }
+
+    RenderStats* getRenderStatsPtr() { return &_renderStats; }
+
     void setSequence(const QVariantList& paths);
 
     void setTargetSize(int size);
@@ -166,11 +270,26 @@ class FloatImageViewer : public QQuickItem
     /// Reload image from source
     void reload();
 
+    /// Set the displayed image, only flagging it as changed when it is a different image
+    void setImage(const std::shared_ptr<FloatImage>& image);
+
+    /// Reload the compared image from compareSource, through the same image server as the image
+    void reloadCompare();
+
     /// Custom QSGNode update
     QSGNode* updatePaintNode(QSGNode* oldNode, QQuickItem::UpdatePaintNodeData* data) override;
 
     void updatePaintSurface(QSGGeometryNode* root, QSGSimpleMaterial<ShaderData>* material, QSGGeometry* geometryLine);
 
+    /// Draw the frame time graph of the latest frames in the top left corner of the item
+    void updatePaintRenderStats(QSGNode* overlay);
+
+    /// Connect the automatic downscale update to the frames of the window displaying this item
+    void onWindowChanged(QQuickWindow* win);
+
+    /// Select the downscale level matching the resolution at which the image is displayed on screen
+    void updateAutoDownscale();
+
     QUrl _source;
     float _gamma = 1.f;
     float _gain = 1.f;
@@ -180,28 +299,65 @@ class FloatImageViewer : public QQuickItem
     bool _outdated = false;
     bool _clearBeforeLoad = true;
 
-    bool _imageChanged = false;
     EChannelMode _channelMode;
+
+    // Exposure diagnostics, thresholds are scene-linear values (after gain)
+    EDiagnosticMode _diagnosticMode = EDiagnosticMode::NONE;
+    float _clippingThreshold = 1.f;
+    float _zebraThreshold = 0.9f;
+
+    QUrl _displayLut;
+    std::shared_ptr<Lut3D> _lut;
+    bool _lutChanged = false;
     std::shared_ptr<FloatImage> _image;
-    QRectF _boundingRect;
+    // Incremented each time _image points to different pixel data
+    int _imageVersion = 0;
+    // Version of the image uploaded in the current texture
+    int _textureImageVersion = -1;
+    int _skippedUploads = 0;
+    // Latest request sent to the image servers
+    imgserve::RequestData _lastRequest;
+    // Source of the displayed image, its texture is shared with the other viewers displaying the same image
+    TextureRegistry::Key _imageTextureKey;
+
+    // A/B comparison
+    QUrl _compareSource;
+    ECompareMode _compareMode = ECompareMode::NONE;
+    float _wipePosition = 0.5f;
+    float _onionSkinOpacity = 0.5f;
+    std::shared_ptr<FloatImage> _compareImage;
+    int _compareImageVersion = 0;
+    TextureRegistry::Key _compareTextureKey;
+    int _textureCompareImageVersion = -1;
     QSize _textureSize;
     QSize _sourceSize = QSize(0, 0);
 
     QVariantMap _metadata;
 
     Surface _surface;
+    ImageStats _imageStats;
+    RenderStats _renderStats;
+    bool _displayRenderStats = false;
+    Painter _renderStatsPainter = Painter({"renderStatsBackground", "renderStatsFrames", "renderStatsHitches", "renderStatsBudget"});
     // Prevent to update surface without the root created
     bool _createRoot = true;
     // Level of downscale for images of a Panorama
     int _downscaleLevel = 0;
+    // Compute the downscale level from the item scale and the window's device pixel ratio.
+    // Only used with the single image loader: the sequence cache relies on its target size.
+    bool _autoDownscale = false;
+    // Keep the current image displayed while a reload triggered by the automatic downscale is pending
+    bool _keepImageOnReload = false;
+    QMetaObject::Connection _windowConnection;
 
     bool _canBeHovered = false;
 
-    bool _cropFisheye = false;
-
     imgserve::SequenceCache _sequenceCache;
     imgserve::SingleImageLoader _singleImageLoader;
     bool _useSequence = true;
+    bool _playback = false;
+    // Number of sequence frames kept resident on the GPU during playback (0 to disable)
+    int _flipbookSize = 8;
 };
 
 }  // namespace qtAliceVision
@@ -6,6 +6,8 @@
 
 #include <QtDebug>
 
+#include <chrono>
+
 namespace qtAliceVision {
 int FloatTexture::_maxTextureSize = -1;
 
@@ -24,10 +26,28 @@ void FloatTexture::setImage(std::shared_ptr<FloatImage>& image)
     _srcImage = image;
     _textureSize = {_srcImage->width(), _srcImage->height()};
     _dirty = true;
+    _dirtyRegions.clear();
     _dirtyBindOptions = true;
     _mipmapsGenerated = false;
 }
 
+void FloatTexture::updateRegion(const QRect& region)
+{
+    if (_dirty || !_srcImage)
+        return;
+
+    // The texture has been downscaled to fit the max texture size: upload it again
+    if (_textureSize != QSize(_srcImage->width(), _srcImage->height()))
+    {
+        _dirty = true;
+        return;
+    }
+
+    const QRect clipped = region.intersected(QRect(QPoint(0, 0), _textureSize));
+    if (!clipped.isEmpty())
+        _dirtyRegions.push_back(clipped);
+}
+
 bool FloatTexture::isValid() const { return _srcImage->width() != 0 && _srcImage->height() != 0; }
 
 int FloatTexture::textureId() const
@@ -54,6 +74,7 @@ void FloatTexture::bind()
     if (!_dirty)
     {
         funcs->glBindTexture(GL_TEXTURE_2D, _textureId);
+        uploadRegions();
         if (mipmapFiltering() != QSGTexture::None && !_mipmapsGenerated)
         {
             funcs->glGenerateMipmap(GL_TEXTURE_2D);
@@ -64,7 +85,22 @@ void FloatTexture::bind()
         return;
     }
 
+    // Upload leaves the texture bound
+    upload();
+}
+
+void FloatTexture::upload()
+{
+    if (!_dirty)
+    {
+        return;
+    }
+
+    QOpenGLFunctions* funcs = QOpenGLContext::currentContext()->functions();
+    const auto tUpload = std::chrono::steady_clock::now();
+
     _dirty = false;
+    _dirtyRegions.clear();
 
     if (!isValid())
     {
@@ -111,6 +147,7 @@ void FloatTexture::bind()
         }
 
         _dirtyBindOptions = false;
+        _uploadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tUpload).count();
     }
     catch (std::exception& e)
     {
@@ -121,4 +158,26 @@ void FloatTexture::bind()
     }
 }
 
+void FloatTexture::uploadRegions()
+{
+    if (_dirtyRegions.empty())
+        return;
+
+    QOpenGLFunctions* funcs = QOpenGLContext::currentContext()->functions();
+    const auto tUpload = std::chrono::steady_clock::now();
+
+    // The rows of the regions are read from the whole image
+    funcs->glPixelStorei(GL_UNPACK_ROW_LENGTH, _srcImage->width());
+    for (const QRect& region : _dirtyRegions)
+    {
+        funcs->glTexSubImage2D(
+          GL_TEXTURE_2D, 0, region.x(), region.y(), region.width(), region.height(), GL_RGBA, GL_FLOAT, &(*_srcImage)(region.y(), region.x()));
+    }
+    funcs->glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    _dirtyRegions.clear();
+
+    _mipmapsGenerated = false;
+    _uploadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tUpload).count();
+}
+
 }  // namespace qtAliceVision
@@ -4,9 +4,11 @@
 #include <aliceVision/image/pixelTypes.hpp>
 #include <aliceVision/types.hpp>
 
+#include <QRect>
 #include <QSGTexture>
 
 #include <memory>
+#include <vector>
 
 namespace qtAliceVision {
 
@@ -30,10 +32,41 @@ class FloatTexture : public QSGTexture
     bool hasMipmaps() const override { return mipmapFiltering() != QSGTexture::None; }
 
     void setImage(std::shared_ptr<FloatImage>& image);
+
+    /**
+     * @brief Upload a region of the image on the next bind, the rest of the texture is left untouched.
+     *
+     * The pixels of the image set with setImage have been modified in place: only the given region is uploaded
+     * (if the whole image still needs to be uploaded, it is uploaded at once).
+     */
+    void updateRegion(const QRect& region);
     const FloatImage& image() { return *_srcImage; }
 
     void bind() override;
 
+    /**
+     * @brief Upload the image to the GPU if it has not been done yet.
+     *
+     * Called by bind() when needed, it can also be called beforehand (with an OpenGL context current)
+     * so that binding the texture later on does not stall.
+     * The texture is left bound on the current texture unit.
+     */
+    void upload();
+
+    /// Whether the image still needs to be uploaded to the GPU
+    bool isUploaded() const { return !_dirty; }
+
+    /**
+     * @brief Get the duration of the latest upload, if it has not been retrieved yet.
+     * @return upload duration in milliseconds (float to half conversion by the driver included), 0 if already retrieved
+     */
+    double takeUploadTime()
+    {
+        const double uploadTime = _uploadTime;
+        _uploadTime = 0.0;
+        return uploadTime;
+    }
+
     /**
      * @brief Get the maximum dimension of a texture.
      *
@@ -46,6 +79,9 @@ class FloatTexture : public QSGTexture
   private:
     bool isValid() const;
 
+    /// Upload the regions of the image modified since the last upload, the texture is left bound
+    void uploadRegions();
+
   private:
     std::shared_ptr<FloatImage> _srcImage;
 
@@ -53,9 +89,13 @@ class FloatTexture : public QSGTexture
     QSize _textureSize;
 
     bool _dirty = false;
+    /// Regions of the image to upload, if the whole image does not need to be uploaded
+    std::vector<QRect> _dirtyRegions;
     bool _dirtyBindOptions = false;
     bool _mipmapsGenerated = false;
 
+    double _uploadTime = 0.0;
+
     static int _maxTextureSize;
 };
 
@@ -43,6 +43,12 @@ struct ResponseData
     QVariantMap metadata;
 
     LoadingStatus error = UNDEFINED;
+
+    /// Time spent decoding the image in milliseconds, only reported with the first delivery of the image (0 otherwise)
+    double decodeTime = 0.0;
+
+    /// Time spent resizing the image in milliseconds, only reported with the first delivery of the image (0 otherwise)
+    double resizeTime = 0.0;
 };
 
 /**
@@ -0,0 +1,233 @@
+#include "ImageStats.hpp"
+
+#include <QThreadPool>
+#include <QtDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace qtAliceVision {
+
+ImageStats::ImageStats(QObject* parent)
+  : QObject(parent),
+    _requestId(std::make_shared<QAtomicInt>(0))
+{}
+
+ImageStats::~ImageStats()
+{
+    // Abort the computation in progress, if any
+    _requestId->fetchAndAddOrdered(1);
+}
+
+void ImageStats::setEnabled(bool enabled)
+{
+    if (_enabled == enabled)
+        return;
+
+    _enabled = enabled;
+    Q_EMIT enabledChanged();
+
+    compute();
+}
+
+void ImageStats::setNbBins(int nbBins)
+{
+    nbBins = std::max(1, nbBins);
+    if (_nbBins == nbBins)
+        return;
+
+    _nbBins = nbBins;
+    Q_EMIT nbBinsChanged();
+
+    compute();
+}
+
+void ImageStats::setImage(const std::shared_ptr<FloatImage>& image)
+{
+    if (_image == image)
+        return;
+
+    _image = image;
+    compute();
+}
+
+void ImageStats::setComputing(bool computing)
+{
+    if (_computing == computing)
+        return;
+
+    _computing = computing;
+    Q_EMIT computingChanged();
+}
+
+void ImageStats::compute()
+{
+    // Any computation in progress is now outdated
+    const int requestId = _requestId->fetchAndAddOrdered(1) + 1;
+
+    if (!_enabled || !_image || _image->width() == 0 || _image->height() == 0)
+    {
+        _stats = ImageStatsData();
+        setComputing(false);
+        Q_EMIT statsChanged();
+        return;
+    }
+
+    setComputing(true);
+
+    auto runnable = new ImageStatsRunnable(_image, _nbBins, requestId, _requestId);
+    connect(runnable, &ImageStatsRunnable::done, this, &ImageStats::onStatsComputed);
+    QThreadPool::globalInstance()->start(runnable);
+}
+
+void ImageStats::onStatsComputed(int requestId, ImageStatsData stats)
+{
+    // Ignore results of outdated computations
+    if (requestId != _requestId->loadAcquire())
+        return;
+
+    _stats = std::move(stats);
+    setComputing(false);
+    Q_EMIT statsChanged();
+}
+
+void ImageStats::fillHistogramSerie(QXYSeries* serie, int channel) const
+{
+    if (serie == nullptr)
+    {
+        qInfo() << "[QtAliceVision] ImageStats::fillHistogramSerie: no serie";
+        return;
+    }
+    serie->clear();
+
+    if (channel < 0 || channel > 3)
+    {
+        qInfo() << "[QtAliceVision] ImageStats::fillHistogramSerie: invalid channel: " << channel;
+        return;
+    }
+
+    const std::vector<int>& hist = _stats.histograms[static_cast<std::size_t>(channel)];
+    if (hist.empty())
+        return;
+
+    const double minValue = static_cast<double>(_stats.minimum[channel]);
+    const double binSize = (static_cast<double>(_stats.maximum[channel]) - minValue) / static_cast<double>(hist.size());
+
+    for (std::size_t i = 0; i < hist.size(); ++i)
+    {
+        // Bin center
+        serie->append(minValue + (static_cast<double>(i) + 0.5) * binSize, static_cast<double>(hist[i]));
+    }
+}
+
+QVariantList ImageStats::histogram(int channel) const
+{
+    QVariantList bins;
+    if (channel < 0 || channel > 3)
+        return bins;
+
+    for (const int count : _stats.histograms[static_cast<std::size_t>(channel)])
+        bins.append(count);
+
+    return bins;
+}
+
+ImageStatsRunnable::ImageStatsRunnable(const std::shared_ptr<FloatImage>& image,
+                                       int nbBins,
+                                       int requestId,
+                                       const std::shared_ptr<QAtomicInt>& latestRequestId)
+  : _image(image),
+    _nbBins(nbBins),
+    _requestId(requestId),
+    _latestRequestId(latestRequestId)
+{}
+
+void ImageStatsRunnable::run()
+{
+    const std::size_t width = static_cast<std::size_t>(_image->width());
+    const std::size_t height = static_cast<std::size_t>(_image->height());
+
+    // Pixels are stored contiguously as RGBA floats.
+    // The channel loops below are kept branch-light over plain float arrays so that they can be auto-vectorized.
+    const float* data = reinterpret_cast<const float*>(_image->data());
+
+    // First pass: min, max and mean
+    float minValues[4];
+    float maxValues[4];
+    double sums[4] = {0.0, 0.0, 0.0, 0.0};
+    std::size_t counts[4] = {0, 0, 0, 0};
+    std::fill(minValues, minValues + 4, std::numeric_limits<float>::max());
+    std::fill(maxValues, maxValues + 4, std::numeric_limits<float>::lowest());
+
+    for (std::size_t y = 0; y < height; ++y)
+    {
+        // Stop as soon as a newer image is being analyzed
+        if (isOutdated())
+            return;
+
+        const float* row = data + y * width * 4;
+        for (std::size_t x = 0; x < width; ++x)
+        {
+            for (std::size_t c = 0; c < 4; ++c)
+            {
+                const float value = row[x * 4 + c];
+                if (!std::isfinite(value))
+                    continue;
+                minValues[c] = std::min(minValues[c], value);
+                maxValues[c] = std::max(maxValues[c], value);
+                sums[c] += static_cast<double>(value);
+                ++counts[c];
+            }
+        }
+    }
+
+    ImageStatsData stats;
+    for (std::size_t c = 0; c < 4; ++c)
+    {
+        if (counts[c] == 0)
+        {
+            minValues[c] = 0.f;
+            maxValues[c] = 0.f;
+        }
+        const int channel = static_cast<int>(c);
+        stats.minimum[channel] = minValues[c];
+        stats.maximum[channel] = maxValues[c];
+        stats.mean[channel] = counts[c] == 0 ? 0.f : static_cast<float>(sums[c] / static_cast<double>(counts[c]));
+        stats.histograms[c].assign(static_cast<std::size_t>(_nbBins), 0);
+    }
+
+    // Second pass: histograms
+    float binScales[4];
+    for (std::size_t c = 0; c < 4; ++c)
+    {
+        const float range = maxValues[c] - minValues[c];
+        binScales[c] = range > 0.f ? static_cast<float>(_nbBins) / range : 0.f;
+    }
+
+    const int lastBin = _nbBins - 1;
+    for (std::size_t y = 0; y < height; ++y)
+    {
+        if (isOutdated())
+            return;
+
+        const float* row = data + y * width * 4;
+        for (std::size_t x = 0; x < width; ++x)
+        {
+            for (std::size_t c = 0; c < 4; ++c)
+            {
+                const float value = row[x * 4 + c];
+                if (!std::isfinite(value))
+                    continue;
+                const int bin = std::min(lastBin, static_cast<int>((value - minValues[c]) * binScales[c]));
+                ++stats.histograms[c][static_cast<std::size_t>(bin)];
+            }
+        }
+    }
+
+    Q_EMIT done(_requestId, stats);
+}
+
+}  // namespace qtAliceVision
+
+#include "ImageStats.moc"
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "FloatTexture.hpp"
+
+#include <QObject>
+#include <QRunnable>
+#include <QVariant>
+#include <QVector4D>
+#include <QAtomicInt>
+#include <QtCharts/QXYSeries>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace qtAliceVision {
+
+QT_CHARTS_USE_NAMESPACE
+
+/**
+ * @brief Utility structure to encapsulate the statistics computed on an image.
+ */
+struct ImageStatsData
+{
+    /// Per-channel (RGBA) minimum value, ignoring non finite values
+    QVector4D minimum;
+
+    /// Per-channel (RGBA) maximum value, ignoring non finite values
+    QVector4D maximum;
+
+    /// Per-channel (RGBA) mean value, ignoring non finite values
+    QVector4D mean;
+
+    /// Per-channel histograms, bins are evenly spread between the channel's minimum and maximum
+    std::array<std::vector<int>, 4> histograms;
+};
+
+/**
+ * @brief Per-channel statistics and histograms of the image displayed in a FloatImageViewer.
+ *
+ * Statistics are computed on a worker thread each time the image changes,
+ * so that neither the UI nor the rendering are stalled.
+ * A computation in progress is aborted as soon as a newer image is provided.
+ */
+class ImageStats : public QObject
+{
+    Q_OBJECT
+
+    /// Enable the computation of the statistics (disabled by default to avoid useless work during playback)
+    Q_PROPERTY(bool enabled READ getEnabled WRITE setEnabled NOTIFY enabledChanged)
+    /// Number of bins of the histograms
+    Q_PROPERTY(int nbBins READ getNbBins WRITE setNbBins NOTIFY nbBinsChanged)
+    /// Whether statistics are currently being computed
+    Q_PROPERTY(bool computing READ getComputing NOTIFY computingChanged)
+    /// Per-channel minimum value
+    Q_PROPERTY(QVector4D minimum READ getMinimum NOTIFY statsChanged)
+    /// Per-channel maximum value
+    Q_PROPERTY(QVector4D maximum READ getMaximum NOTIFY statsChanged)
+    /// Per-channel mean value
+    Q_PROPERTY(QVector4D mean READ getMean NOTIFY statsChanged)
+
+  public:
+    explicit ImageStats(QObject* parent = nullptr);
+    ~ImageStats() override;
+
+    bool getEnabled() const { return _enabled; }
+    void setEnabled(bool enabled);
+
+    int getNbBins() const { return _nbBins; }
+    void setNbBins(int nbBins);
+
+    bool getComputing() const { return _computing; }
+
+    QVector4D getMinimum() const { return _stats.minimum; }
+    QVector4D getMaximum() const { return _stats.maximum; }
+    QVector4D getMean() const { return _stats.mean; }
+
+    /**
+     * @brief Set the image on which the statistics are computed.
+     * @param[in] image image to analyze (can be null)
+     */
+    void setImage(const std::shared_ptr<FloatImage>& image);
+
+    /**
+     * @brief Fill a chart serie with the histogram of a channel.
+     * @param[in] serie chart serie to fill
+     * @param[in] channel channel index (0: R, 1: G, 2: B, 3: A)
+     */
+    Q_INVOKABLE void fillHistogramSerie(QXYSeries* serie, int channel) const;
+
+    /**
+     * @brief Get the histogram of a channel.
+     * @param[in] channel channel index (0: R, 1: G, 2: B, 3: A)
+     * @return bin counts, bins are evenly spread between the channel's minimum and maximum
+     */
+    Q_INVOKABLE QVariantList histogram(int channel) const;
+
+    /**
+     * @brief Slot called when the worker thread is done.
+     * @param[in] requestId identifier of the computation
+     * @param[in] stats computed statistics
+     */
+    Q_SLOT void onStatsComputed(int requestId, ImageStatsData stats);
+
+    Q_SIGNAL void enabledChanged();
+    Q_SIGNAL void nbBinsChanged();
+    Q_SIGNAL void computingChanged();
+    Q_SIGNAL void statsChanged();
+
+  private:
+    /// Launch the computation on the current image, aborting any computation in progress
+    void compute();
+
+    void setComputing(bool computing);
+
+  private:
+    bool _enabled = false;
+    int _nbBins = 256;
+    bool _computing = false;
+
+    std::shared_ptr<FloatImage> _image;
+    ImageStatsData _stats;
+
+    /// Identifier of the latest computation, shared with the worker threads to abort outdated computations
+    std::shared_ptr<QAtomicInt> _requestId;
+};
+
+/**
+ * @brief QRunnable object dedicated to computing the statistics of an image.
+ */
+class ImageStatsRunnable : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+  public:
+    /**
+     * @param[in] image image to analyze
+     * @param[in] nbBins number of histogram bins
+     * @param[in] requestId identifier of this computation
+     * @param[in] latestRequestId identifier of the latest computation, used to abort outdated computations
+     */
+    ImageStatsRunnable(const std::shared_ptr<FloatImage>& image, int nbBins, int requestId, const std::shared_ptr<QAtomicInt>& latestRequestId);
+
+    /// Compute the statistics in a worker thread
+    Q_SLOT void run() override;
+
+    /**
+     * @brief Signal emitted when the statistics have been computed.
+     * @param[in] requestId identifier of the computation
+     * @param[in] stats computed statistics
+     */
+    Q_SIGNAL void done(int requestId, ImageStatsData stats);
+
+  private:
+    bool isOutdated() const { return _latestRequestId->loadAcquire() != _requestId; }
+
+  private:
+    std::shared_ptr<FloatImage> _image;
+    int _nbBins;
+    int _requestId;
+    std::shared_ptr<QAtomicInt> _latestRequestId;
+};
+
+}  // namespace qtAliceVision
+
+Q_DECLARE_METATYPE(qtAliceVision::ImageStatsData)
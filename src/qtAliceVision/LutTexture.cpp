@@ -0,0 +1,165 @@
+#include "LutTexture.hpp"
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+#include <QtDebug>
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace qtAliceVision {
+
+std::shared_ptr<Lut3D> loadCubeLut(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("Cannot open LUT file: " + path);
+    }
+
+    auto lut = std::make_shared<Lut3D>();
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream stream(line);
+        std::string keyword;
+        if (!(stream >> keyword) || keyword[0] == '#')
+        {
+            // Empty line or comment
+            continue;
+        }
+
+        if (keyword == "TITLE")
+        {
+            continue;
+        }
+        else if (keyword == "LUT_3D_SIZE")
+        {
+            stream >> lut->size;
+            if (lut->size < 2 || lut->size > 256)
+            {
+                throw std::runtime_error("Invalid LUT_3D_SIZE in LUT file: " + path);
+            }
+            lut->data.reserve(static_cast<std::size_t>(lut->size * lut->size * lut->size) * 3);
+        }
+        else if (keyword == "DOMAIN_MIN" || keyword == "DOMAIN_MAX")
+        {
+            float r, g, b;
+            if (!(stream >> r >> g >> b))
+            {
+                throw std::runtime_error("Invalid " + keyword + " in LUT file: " + path);
+            }
+            (keyword == "DOMAIN_MIN" ? lut->domainMin : lut->domainMax) = QVector3D(r, g, b);
+        }
+        else if (keyword == "LUT_3D_INPUT_RANGE")
+        {
+            // Resolve flavour of the format: same domain for all the channels
+            float min, max;
+            if (!(stream >> min >> max))
+            {
+                throw std::runtime_error("Invalid " + keyword + " in LUT file: " + path);
+            }
+            lut->domainMin = QVector3D(min, min, min);
+            lut->domainMax = QVector3D(max, max, max);
+        }
+        else if (keyword == "LUT_1D_SIZE")
+        {
+            throw std::runtime_error("1D LUTs are not supported: " + path);
+        }
+        else
+        {
+            // Data line: the keyword is actually the red value
+            std::istringstream values(line);
+            float r, g, b;
+            if (!(values >> r >> g >> b))
+            {
+                throw std::runtime_error("Invalid line in LUT file: " + path + ": " + line);
+            }
+            lut->data.push_back(r);
+            lut->data.push_back(g);
+            lut->data.push_back(b);
+        }
+    }
+
+    const std::size_t expectedSize = static_cast<std::size_t>(lut->size * lut->size * lut->size) * 3;
+    if (lut->size == 0 || lut->data.size() != expectedSize)
+    {
+        throw std::runtime_error("Incomplete LUT file: " + path);
+    }
+
+    // The shader divides by the extent of the domain
+    for (int c = 0; c < 3; ++c)
+    {
+        if (!(lut->domainMax[c] > lut->domainMin[c]))
+        {
+            throw std::runtime_error("Empty LUT domain in LUT file: " + path);
+        }
+    }
+
+    return lut;
+}
+
+LutTexture::LutTexture() {}
+
+LutTexture::~LutTexture()
+{
+    if (_textureId && QOpenGLContext::currentContext())
+    {
+        QOpenGLContext::currentContext()->functions()->glDeleteTextures(1, &_textureId);
+    }
+}
+
+QSize LutTexture::textureSize() const
+{
+    // A 3D texture cannot be described by a QSize: report one slice
+    return _lut ? QSize(_lut->size, _lut->size) : QSize();
+}
+
+void LutTexture::setLut(const std::shared_ptr<Lut3D>& lut)
+{
+    _lut = lut;
+    _dirty = true;
+}
+
+void LutTexture::bind()
+{
+    QOpenGLExtraFunctions* funcs = QOpenGLContext::currentContext()->extraFunctions();
+
+    if (!_dirty)
+    {
+        funcs->glBindTexture(GL_TEXTURE_3D, _textureId);
+        return;
+    }
+
+    _dirty = false;
+
+    if (!_lut)
+    {
+        if (_textureId)
+        {
+            funcs->glDeleteTextures(1, &_textureId);
+        }
+        _textureId = 0;
+        return;
+    }
+
+    if (_textureId == 0)
+    {
+        funcs->glGenTextures(1, &_textureId);
+    }
+    funcs->glBindTexture(GL_TEXTURE_3D, _textureId);
+
+    // Trilinear interpolation between LUT samples, no wrapping at the domain boundaries
+    funcs->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    funcs->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    funcs->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    funcs->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    funcs->glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    funcs->glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB16F, _lut->size, _lut->size, _lut->size, 0, GL_RGB, GL_FLOAT, _lut->data.data());
+}
+
+}  // namespace qtAliceVision
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QSGTexture>
+#include <QVector3D>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace qtAliceVision {
+
+/**
+ * @brief 3D color lookup table, as stored in .cube files (e.g. baked from an OpenColorIO display/view transform).
+ */
+struct Lut3D
+{
+    /// Number of samples along each axis
+    int size = 0;
+
+    /// Input value mapped to the first sample of each axis
+    QVector3D domainMin = QVector3D(0.f, 0.f, 0.f);
+
+    /// Input value mapped to the last sample of each axis
+    QVector3D domainMax = QVector3D(1.f, 1.f, 1.f);
+
+    /// RGB output values, red index varying fastest then green then blue (size^3 * 3 floats)
+    std::vector<float> data;
+};
+
+/**
+ * @brief Load a 3D LUT from a .cube file (Adobe/Resolve format).
+ * @param[in] path filepath of the .cube file
+ * @return the loaded LUT
+ * @throw std::runtime_error if the file cannot be read or is not a valid 3D LUT
+ */
+std::shared_ptr<Lut3D> loadCubeLut(const std::string& path);
+
+/**
+ * @brief A QSGTexture holding a 3D LUT, sampled with trilinear filtering in the image shader.
+ */
+class LutTexture : public QSGTexture
+{
+  public:
+    LutTexture();
+    ~LutTexture() override;
+
+    int textureId() const override { return static_cast<int>(_textureId); }
+
+    QSize textureSize() const override;
+
+    bool hasAlphaChannel() const override { return false; }
+
+    bool hasMipmaps() const override { return false; }
+
+    void setLut(const std::shared_ptr<Lut3D>& lut);
+    const Lut3D& lut() const { return *_lut; }
+
+    /// Bind the 3D texture on the current texture unit, uploading the LUT if needed.
+    void bind() override;
+
+  private:
+    std::shared_ptr<Lut3D> _lut;
+
+    unsigned int _textureId = 0;
+
+    bool _dirty = false;
+};
+
+}  // namespace qtAliceVision
@@ -90,6 +90,8 @@ class MSfMData : public QObject
     Status status() const { return _status; }
     void setStatus(Status status);
 
+    const QUrl& sfmDataPath() const { return _sfmDataPath; }
+
     size_t nbCameras() const;
 
     QVariantList getViewsIds() const;
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <aliceVision/numeric/numeric.hpp>
+
+#include <QtGlobal>
+
+// Import M_PI
+#include <math.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+/**
+ * Projection of the panorama meshes, shared by the FloatImageViewer surfaces and the composite of the PanoramaViewer.
+ *
+ * The meshes hold the longitudes and latitudes of their vertices on the unit sphere, they are rotated and projected
+ * in the equirectangular panorama by the vertex shaders. The longitudes of the vertices of an image are unwrapped
+ * around the longitude of its center, so that its triangles do not wrap around the panorama.
+ * The part of the image past the seam of the panorama is drawn by a copy of its mesh, identified by longitudes offset
+ * by 4 pi and unwrapped on the other side of the panorama. The copy is collapsed when the image does not cross the seam.
+ */
+
+namespace qtAliceVision {
+
+/// Longitude offset of the copy of the panorama meshes drawn across the seam
+constexpr float panoramaSeamCopyOffset = static_cast<float>(4.0 * M_PI);
+
+/**
+ * @brief GLSL function projecting a vertex of a panorama mesh in the panorama.
+ *
+ * highp vec2 projectPanoramaVertex(highp vec2 vertex, highp mat3 rotation, highp vec4 center, highp vec2 panoramaSize)
+ * - vertex: longitude and latitude of the vertex on the unit sphere, longitude offset by 4 pi for the copy of the mesh
+ * - rotation: rotation of the panorama
+ * - center: direction of the center of the image on the unit sphere (xyz),
+ *           and largest angle between the center and the vertices of the image (w)
+ * - panoramaSize: size of the panorama
+ * Also defines the PI constant.
+ */
+constexpr char panoramaProjectionShader[] =
+  "const highp float PI = 3.14159265358979;                                          \n"
+  "highp vec2 projectPanoramaVertex(highp vec2 vertex, highp mat3 rotation, highp vec4 center, highp vec2 panoramaSize) { \n"
+  "    highp float cosLatitude = cos(vertex.y);                                      \n"
+  "    highp vec3 direction = rotation * vec3(cosLatitude * sin(vertex.x), sin(vertex.y), cosLatitude * cos(vertex.x)); \n"
+  "    highp vec3 rotatedCenter = rotation * center.xyz;                             \n"
+  "    highp float centerLongitude = atan(rotatedCenter.x, rotatedCenter.z);         \n"
+  "    highp float centerLatitude = asin(clamp(rotatedCenter.y, -1.0, 1.0));         \n"
+  "    // longitudes covered by the image: those of the cap of radius center.w around its center \n"
+  "    highp float halfWidth = abs(centerLatitude) + center.w >= 0.5 * PI ? PI : asin(min(sin(center.w) / cos(centerLatitude), 1.0)); \n"
+  "    highp float seam = centerLongitude + halfWidth > PI ? 1.0 : (centerLongitude - halfWidth < -PI ? -1.0 : 0.0); \n"
+  "    // the copy of the mesh is unwrapped on the other side of the seam            \n"
+  "    highp float seamCopy = step(3.0 * PI, vertex.x);                              \n"
+  "    if (seamCopy > 0.5 && seam == 0.0) return vec2(-1.0);                         \n"
+  "    highp float unwrapCenter = centerLongitude - 2.0 * PI * seam * seamCopy;      \n"
+  "    highp float longitude = atan(direction.x, direction.z);                       \n"
+  "    longitude -= 2.0 * PI * floor((longitude - unwrapCenter + PI) / (2.0 * PI));  \n"
+  "    highp float latitude = asin(clamp(direction.y, -1.0, 1.0));                   \n"
+  "    return vec2((longitude + PI) / (2.0 * PI), (latitude + 0.5 * PI) / PI) * panoramaSize; \n"
+  "}                                                                                 \n";
+
+/**
+ * @brief Whether the cap covered by an image on the unit sphere contains a pole of the rotated panorama.
+ * Such an image covers all the longitudes (see projectPanoramaVertex): some cells of its mesh straddle
+ * the longitude where it is unwrapped, and would be stretched across the whole panorama.
+ * @param[in] rotatedCenter direction of the center of the image in the rotated panorama
+ * @param[in] radius largest angle between the center and the vertices of the image
+ */
+inline bool panoramaCapContainsPole(const aliceVision::Vec3& rotatedCenter, double radius)
+{
+    return std::abs(std::asin(std::clamp(rotatedCenter.y(), -1.0, 1.0))) + radius >= M_PI_2;
+}
+
+/**
+ * @brief Replace the cells of a panorama mesh that straddle the longitude where it is unwrapped by degenerate triangles.
+ * @param[in] projected positions of the vertices of the mesh in the panorama, unwrapped around the center of the image
+ * @param[in] panoramaWidth width of the panorama
+ * @param[in] firstVertex index of the first vertex of the mesh in the geometry
+ * @param[in,out] indices indices of the cells of the mesh, two triangles per cell
+ * @param[in] indexCount number of indices of the mesh
+ */
+inline void dropPanoramaCutCells(const Eigen::Ref<const Eigen::Matrix2Xd>& projected,
+                                 double panoramaWidth,
+                                 quint32 firstVertex,
+                                 quint32* indices,
+                                 std::size_t indexCount)
+{
+    for (std::size_t i = 0; i + 6 <= indexCount; i += 6)
+    {
+        double minX = std::numeric_limits<double>::max();
+        double maxX = std::numeric_limits<double>::lowest();
+        for (std::size_t k = i; k < i + 6; ++k)
+        {
+            const double x = projected(0, static_cast<Eigen::Index>(indices[k] - firstVertex));
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+        }
+
+        // Neighbouring vertices are far less than half a panorama apart, unless they are on both sides of the cut
+        if (maxX - minX > 0.5 * panoramaWidth)
+            std::fill(indices + i, indices + i + 6, indices[i]);
+    }
+}
+
+}  // namespace qtAliceVision
@@ -2,12 +2,17 @@
 #include "FloatImageViewer.hpp"
 #include "FloatTexture.hpp"
 #include "ShaderImageViewer.hpp"
+#include "ShaderPanoramaViewer.hpp"
 
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
 #include <QSGGeometry>
 #include <QSGGeometryNode>
 #include <QSGSimpleMaterial>
 #include <QSGSimpleMaterialShader>
 #include <QSGTexture>
+#include <QThread>
 #include <QThreadPool>
 
 #include <aliceVision/camera/cameraUndistortImage.hpp>
@@ -17,7 +22,107 @@
 
 #include <aliceVision/system/MemoryInfo.hpp>
 
+#include <OpenImageIO/imageio.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
 namespace qtAliceVision {
+
+namespace {
+
+/// Maximum size of the atlas of the composite, the tiles get smaller as the number of views grows
+constexpr int maxAtlasSize = 2048;
+
+/// Maximum size of a tile of the atlas
+constexpr int maxTileSize = 256;
+
+/// Subdivisions of the mesh of each view of the composite
+constexpr int compositeSubdivisions = 12;
+
+/// Number of samples along each axis of the images to estimate their footprint in the panorama
+constexpr int footprintSamples = 5;
+
+/// Coarsest downscale level of the views
+constexpr int maxDownscaleLevel = 8;
+
+/// Memory used by a pixel of a loaded image (RGBA float)
+constexpr double bytesPerPixel = 4.0 * sizeof(float);
+
+/**
+ * @brief Resolution of the content of a tile loaded at a downscale level.
+ * @param[in] imageSize smallest dimension of the source image
+ * @param[in] level downscale level of the view
+ * @param[in] tileSize size of the tiles of the atlas
+ * @return the resolution of the tile, the rest of the way to the tile size is interpolated
+ */
+int getTileResolution(int imageSize, int level, int tileSize) { return std::clamp(imageSize >> level, 1, tileSize); }
+
+/**
+ * @brief Read the coarsest mip level of an image that still has the resolution of a tile at a downscale level.
+ * @param[in] path filepath of the image
+ * @param[in] level downscale level of the view
+ * @param[in] tileSize size of the tiles of the atlas
+ * @param[out] image pixels of the mip level, in linear RGBA
+ * @param[out] imageSize smallest dimension of the image at full resolution
+ * @return false if the image has no mip level coarser than the full resolution: the whole image has to be decoded
+ */
+bool readCoarseMipLevel(const std::string& path, int level, int tileSize, FloatImage& image, int& imageSize)
+{
+    std::unique_ptr<oiio::ImageInput> input = oiio::ImageInput::open(path);
+    if (!input)
+        return false;
+
+    imageSize = std::min(input->spec().width, input->spec().height);
+    const int resolution = getTileResolution(imageSize, level, tileSize);
+    int mipLevel = 0;
+    while (input->seek_subimage(0, mipLevel + 1) && std::min(input->spec().width, input->spec().height) >= resolution)
+        ++mipLevel;
+    if (mipLevel == 0 || !input->seek_subimage(0, mipLevel))
+        return false;
+
+    const oiio::ImageSpec spec = input->spec();
+    const int nchannels = std::min(spec.nchannels, 4);
+    std::vector<float> pixels(static_cast<std::size_t>(spec.width) * static_cast<std::size_t>(spec.height) * static_cast<std::size_t>(nchannels));
+    if (nchannels < 1 || !input->read_image(0, mipLevel, 0, nchannels, oiio::TypeDesc::FLOAT, pixels.data()))
+        return false;
+    input->close();
+
+    // Mip levels come with tiled EXR or TX files, which are linear unless tagged otherwise
+    const bool srgb = spec.get_string_attribute("oiio:ColorSpace") == "sRGB";
+    const auto toLinear = [srgb](float value) {
+        if (!srgb)
+            return value;
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+    };
+
+    image.resize(spec.width, spec.height);
+    for (int y = 0; y < spec.height; ++y)
+    {
+        for (int x = 0; x < spec.width; ++x)
+        {
+            const float* values = &pixels[(static_cast<std::size_t>(y) * static_cast<std::size_t>(spec.width) + static_cast<std::size_t>(x)) *
+                                          static_cast<std::size_t>(nchannels)];
+            aliceVision::image::RGBAfColor& pixel = image(y, x);
+            // Gray images are expanded to RGB, images without alpha are opaque
+            const int alpha = nchannels == 2 || nchannels == 4 ? nchannels - 1 : -1;
+            for (int c = 0; c < 3; ++c)
+                pixel[c] = toLinear(values[nchannels < 3 ? 0 : c]);
+            pixel[3] = alpha >= 0 ? values[alpha] : 1.f;
+        }
+    }
+    return true;
+}
+
+/// Suffix of the preview of the composite, saved next to the SfMData file
+const QString previewSuffix = QStringLiteral("_panoramaPreview.exr");
+
+/// Metadata of the preview holding the layout of the atlas
+constexpr char previewKeyAttribute[] = "QtAliceVision:panoramaPreview";
+
+}  // namespace
+
 PanoramaViewer::PanoramaViewer(QQuickItem* parent)
   : QQuickItem(parent)
 {
@@ -25,9 +130,433 @@ PanoramaViewer::PanoramaViewer(QQuickItem* parent)
     connect(this, &PanoramaViewer::sourceSizeChanged, this, &PanoramaViewer::update);
     connect(this, &PanoramaViewer::downscaleChanged, this, &PanoramaViewer::update);
     connect(this, &PanoramaViewer::sfmDataChanged, this, &PanoramaViewer::msfmDataUpdate);
+    connect(this, &PanoramaViewer::gammaChanged, this, &PanoramaViewer::update);
+    connect(this, &PanoramaViewer::gainChanged, this, &PanoramaViewer::update);
+    connect(this, &PanoramaViewer::featherChanged, this, &PanoramaViewer::update);
+    connect(this, &PanoramaViewer::anglesChanged, this, &PanoramaViewer::update);
+    connect(this, &PanoramaViewer::anglesChanged, this, [this]() { _compositeIndicesChanged = true; });
+    connect(this, &PanoramaViewer::anglesChanged, this, &PanoramaViewer::updateViewDownscales);
+    connect(this, &PanoramaViewer::viewportChanged, this, &PanoramaViewer::updateViewDownscales);
+}
+
+PanoramaViewer::~PanoramaViewer()
+{
+    // Abort the loadings in progress, if any
+    _compositeRequestId->fetchAndAddOrdered(1);
+    _tilePool.clear();
+}
+
+int PanoramaViewer::viewDownscale(int viewId) const
+{
+    const auto it = _viewDownscales.find(static_cast<aliceVision::IndexT>(viewId));
+    return it != _viewDownscales.end() ? it->second : -1;
+}
+
+bool PanoramaViewer::hasViewport() const { return !_viewport.isEmpty() && !_viewportSize.isEmpty(); }
+
+void PanoramaViewer::computeViewFootprints()
+{
+    _footprints.clear();
+
+    // The memory budget is only read once per SfMData, not on each change of the viewport
+    const aliceVision::system::MemoryInfo memInfo = aliceVision::system::getMemoryInfo();
+    _memoryBudget = 0.5 * static_cast<double>(memInfo.freeRam);
+
+    if (!_msfmData || _msfmData->status() != MSfMData::Status::Ready)
+    {
+        updateViewDownscales();
+        return;
+    }
+
+    const aliceVision::sfmData::SfMData& sfmData = _msfmData->rawData();
+    for (const auto& viewIt : sfmData.getViews())
+    {
+        const aliceVision::sfmData::View& view = *viewIt.second;
+        if (!sfmData.isPoseAndIntrinsicDefined(&view))
+            continue;
+
+        const aliceVision::camera::IntrinsicBase* intrinsic = sfmData.getIntrinsicPtr(view.getIntrinsicId());
+        const aliceVision::geometry::Pose3 pose = sfmData.getPose(view).getTransform();
+
+        ViewFootprint footprint;
+        footprint.viewId = viewIt.first;
+        footprint.imageWidth = static_cast<int>(view.getImage().getWidth());
+        footprint.imageHeight = static_cast<int>(view.getImage().getHeight());
+        footprint.samples.resize(3, footprintSamples * footprintSamples);
+        for (int i = 0; i < footprintSamples; ++i)
+        {
+            for (int j = 0; j < footprintSamples; ++j)
+            {
+                const aliceVision::Vec2 pixel(footprint.imageWidth * i / (footprintSamples - 1.0), footprint.imageHeight * j / (footprintSamples - 1.0));
+                footprint.samples.col(i * footprintSamples + j) = aliceVision::camera::applyIntrinsicExtrinsic(pose, intrinsic, pixel);
+            }
+        }
+        footprint.center = aliceVision::camera::applyIntrinsicExtrinsic(
+          pose, intrinsic, aliceVision::Vec2(0.5 * footprint.imageWidth, 0.5 * footprint.imageHeight));
+        _footprints.push_back(std::move(footprint));
+    }
+
+    // A tile loading decodes the whole source image unless it has mip levels:
+    // only run as many of them at once as there are full resolution images fitting in the memory budget
+    double largestImage = 0.0;
+    for (const ViewFootprint& footprint : _footprints)
+        largestImage = std::max(largestImage, static_cast<double>(footprint.imageWidth) * footprint.imageHeight * bytesPerPixel);
+    if (largestImage > 0.0)
+    {
+        const double maxLoadings = std::min(static_cast<double>(QThread::idealThreadCount()), _memoryBudget / largestImage);
+        _tilePool.setMaxThreadCount(std::max(1, static_cast<int>(maxLoadings)));
+    }
+
+    updateViewDownscales();
+}
+
+void PanoramaViewer::updateViewDownscales()
+{
+    _viewDownscales.clear();
+
+    // Without viewport, all the views are visible at the global downscale
+    const double screenScale = hasViewport() ? _viewportSize.width() / _viewport.width() : 1.0;
+
+    const Eigen::Matrix3d rotation = getPanoramaRotation();
+    const double panoramaWidth = static_cast<double>(_sourceSize.width());
+
+    struct VisibleView
+    {
+        aliceVision::IndexT viewId;
+        double pixels;
+        int level;
+    };
+    std::vector<VisibleView> visibleViews;
+
+    for (const ViewFootprint& footprint : _footprints)
+    {
+        if (!hasViewport())
+        {
+            visibleViews.push_back({footprint.viewId, static_cast<double>(footprint.imageWidth) * footprint.imageHeight, _downscale});
+            continue;
+        }
+
+        // Bounding box of the view in the panorama, unwrapped around its center
+        const aliceVision::Vec3 center = rotation * footprint.center;
+        Eigen::Matrix2Xd projected(2, footprint.samples.cols());
+        toEquirectangular(
+          footprint.samples, rotation, _sourceSize.width(), _sourceSize.height(), std::atan2(center.x(), center.z()), projected);
+        const QRectF bounds(QPointF(projected.row(0).minCoeff(), projected.row(1).minCoeff()),
+                            QPointF(projected.row(0).maxCoeff(), projected.row(1).maxCoeff()));
+
+        // The view may also be visible on the other side of the seam
+        const bool visible = bounds.intersects(_viewport) || bounds.translated(panoramaWidth, 0.0).intersects(_viewport) ||
+                             bounds.translated(-panoramaWidth, 0.0).intersects(_viewport);
+        if (!visible)
+        {
+            _viewDownscales[footprint.viewId] = -1;
+            continue;
+        }
+
+        // Image pixels per screen pixel, along the axis that needs the most resolution
+        const double ratio = std::min(footprint.imageWidth / std::max(1.0, bounds.width() * screenScale),
+                                      footprint.imageHeight / std::max(1.0, bounds.height() * screenScale));
+        const int level = std::clamp(static_cast<int>(std::floor(std::log2(std::max(1.0, ratio)))), 0, maxDownscaleLevel);
+        visibleViews.push_back({footprint.viewId, static_cast<double>(footprint.imageWidth) * footprint.imageHeight, level});
+    }
+
+    // Ensure the visible views fit in the memory budget, downscaling the largest loaded images first
+    const auto memory = [](const VisibleView& view) { return view.pixels * bytesPerPixel / std::pow(4.0, view.level); };
+
+    double totalMemory = 0.0;
+    for (const VisibleView& view : visibleViews)
+        totalMemory += memory(view);
+
+    while (totalMemory > _memoryBudget && !visibleViews.empty())
+    {
+        auto largest = std::max_element(visibleViews.begin(), visibleViews.end(), [&](const VisibleView& a, const VisibleView& b) {
+            return (a.level < maxDownscaleLevel ? memory(a) : 0.0) < (b.level < maxDownscaleLevel ? memory(b) : 0.0);
+        });
+        if (largest->level >= maxDownscaleLevel)
+            break;
+
+        totalMemory -= memory(*largest);
+        ++largest->level;
+        totalMemory += memory(*largest);
+    }
+
+    for (const VisibleView& view : visibleViews)
+        _viewDownscales[view.viewId] = view.level;
+
+    Q_EMIT viewDownscalesChanged();
+
+    updateCompositeTiles();
+}
+
+void PanoramaViewer::setCompositeViews(bool composite)
+{
+    if (_compositeViews == composite)
+        return;
+
+    _compositeViews = composite;
+    Q_EMIT compositeViewsChanged();
+
+    resetComposite();
+}
+
+void PanoramaViewer::resetComposite()
+{
+    // Loadings in progress are outdated
+    const int requestId = _compositeRequestId->fetchAndAddOrdered(1) + 1;
+
+    _composite.clear();
+    _compositeGeometryViews.clear();
+    _atlas.reset();
+    _atlasChanged = true;
+    _atlasReset = true;
+    _compositeGeometryChanged = true;
+    _loadTiles = false;
+    _pendingTileCount = 0;
+    _failedTileCount = 0;
+    _savePreview = false;
+    _pendingPreview.reset();
+    if (_compositeViewCount != 0)
+    {
+        _compositeViewCount = 0;
+        Q_EMIT compositeViewCountChanged();
+    }
+    if (_previewLoaded)
+    {
+        _previewLoaded = false;
+        Q_EMIT previewLoadedChanged();
+    }
+    update();
+
+    if (!_compositeViews || !_msfmData || _msfmData->status() != MSfMData::Status::Ready)
+        return;
+
+    const aliceVision::sfmData::SfMData& sfmData = _msfmData->rawData();
+    for (const auto& viewIt : sfmData.getViews())
+    {
+        if (sfmData.isPoseAndIntrinsicDefined(viewIt.second.get()))
+        {
+            CompositeView compositeView;
+            compositeView.viewId = viewIt.first;
+            compositeView.imageSize = static_cast<int>(std::min(viewIt.second->getImage().getWidth(), viewIt.second->getImage().getHeight()));
+            _composite.push_back(std::move(compositeView));
+        }
+    }
+    if (_composite.empty())
+        return;
+
+    // Square tiles on a square atlas
+    _atlasColumns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(_composite.size()))));
+    _tileSize = std::min(maxTileSize, maxAtlasSize / _atlasColumns);
+    const int atlasRows = (static_cast<int>(_composite.size()) + _atlasColumns - 1) / _atlasColumns;
+    _atlas = std::make_shared<FloatImage>(_atlasColumns * _tileSize, atlasRows * _tileSize, true, aliceVision::image::RGBAfColor(0.f, 0.f, 0.f, 0.f));
+
+    for (std::size_t i = 0; i < _composite.size(); ++i)
+    {
+        const int index = static_cast<int>(i);
+        const aliceVision::sfmData::View& view = sfmData.getView(_composite[i].viewId);
+
+        // The mesh of each view is computed the same way as the surface of a FloatImageViewer in the panorama viewer
+        SurfaceVerticesParams params;
+        params.subdivisions = compositeSubdivisions;
+        params.textureSize = QSize(static_cast<int>(view.getImage().getWidth()), static_cast<int>(view.getImage().getHeight()));
+        params.intrinsic.reset(sfmData.getIntrinsicPtr(view.getIntrinsicId())->clone());
+        params.pose = sfmData.getPose(view).getTransform();
+        params.panorama = true;
+        // Only the inside of the fisheye circles is blended in the composite
+        params.cropFisheye = true;
+
+        auto meshRunnable = new SurfaceVerticesRunnable(std::move(params), requestId, _compositeRequestId);
+        connect(meshRunnable, &SurfaceVerticesRunnable::done, this, [this, index](int meshRequestId, SurfaceVerticesData data) {
+            onMeshComputed(meshRequestId, index, std::move(data));
+        });
+        QThreadPool::globalInstance()->start(meshRunnable);
+    }
+
+    // A preview saved after the SfMData and its source images were last modified replaces the loading of all the source images
+    const QString previewPath = getPreviewPath();
+    const QFileInfo previewFile(previewPath);
+    if (_persistPreview && previewFile.exists() &&
+        previewFile.lastModified() >= QFileInfo(_msfmData->sfmDataPath().toLocalFile()).lastModified())
+    {
+        std::vector<std::string> imagePaths;
+        imagePaths.reserve(_composite.size());
+        for (const CompositeView& compositeView : _composite)
+            imagePaths.push_back(sfmData.getView(compositeView.viewId).getImage().getImagePath());
+
+        auto previewRunnable =
+          new PanoramaPreviewReadRunnable(previewPath.toStdString(), getPreviewKey(), std::move(imagePaths), requestId, _compositeRequestId);
+        connect(previewRunnable, &PanoramaPreviewReadRunnable::done, this, &PanoramaViewer::onPreviewLoaded);
+        QThreadPool::globalInstance()->start(previewRunnable);
+    }
+    else
+    {
+        loadCompositeTiles(requestId);
+    }
+}
+
+void PanoramaViewer::loadCompositeTiles(int requestId)
+{
+    // Ignore outdated requests
+    if (requestId != _compositeRequestId->loadAcquire())
+        return;
+
+    _loadTiles = true;
+    _pendingTileCount = static_cast<int>(_composite.size());
+    _failedTileCount = 0;
+    updateCompositeTiles();
+}
+
+void PanoramaViewer::updateCompositeTiles()
+{
+    if (!_loadTiles || !_msfmData || _msfmData->status() != MSfMData::Status::Ready)
+        return;
+
+    const int requestId = _compositeRequestId->loadAcquire();
+    const aliceVision::sfmData::SfMData& sfmData = _msfmData->rawData();
+    for (std::size_t i = 0; i < _composite.size(); ++i)
+    {
+        CompositeView& compositeView = _composite[i];
+        if (compositeView.tileDone)
+            continue;
+
+        // Without viewport, or without the size of the image to compare resolutions, the tiles are loaded at the resolution of the atlas
+        int level = 0;
+        if (hasViewport() && compositeView.imageSize > 0)
+        {
+            const auto it = _viewDownscales.find(compositeView.viewId);
+            level = it != _viewDownscales.end() ? it->second : 0;
+        }
+
+        // Off-screen views are loaded once they become visible,
+        // and visible views are reloaded when they need a higher resolution than their current tile
+        if (level < 0)
+            continue;
+        if (compositeView.tileLevel >= 0 && getTileResolution(compositeView.imageSize, level, _tileSize) <=
+                                              getTileResolution(compositeView.imageSize, compositeView.tileLevel, _tileSize))
+            continue;
+
+        compositeView.tileLevel = level;
+        const aliceVision::sfmData::View& view = sfmData.getView(compositeView.viewId);
+        auto tileRunnable =
+          new PanoramaTileRunnable(view.getImage().getImagePath(), _tileSize, level, static_cast<int>(i), requestId, _compositeRequestId);
+        connect(tileRunnable, &PanoramaTileRunnable::done, this, &PanoramaViewer::onTileLoaded);
+        _tilePool.start(tileRunnable);
+    }
+}
+
+void PanoramaViewer::onPreviewLoaded(int requestId, std::shared_ptr<FloatImage> preview)
+{
+    // Ignore results of outdated loadings
+    if (requestId != _compositeRequestId->loadAcquire() || !_atlas)
+        return;
+
+    // The preview does not match the composite: load the source images instead
+    if (!preview || preview->width() != _atlas->width() || preview->height() != _atlas->height())
+    {
+        loadCompositeTiles(requestId);
+        return;
+    }
+
+    // Copied in the atlas on the next synchronization with the render thread
+    _pendingPreview = preview;
+    for (CompositeView& compositeView : _composite)
+    {
+        compositeView.tileReady = true;
+        compositeView.tileDone = true;
+        _compositeGeometryChanged |= compositeView.meshReady;
+    }
+    _atlasChanged = true;
+    _previewLoaded = true;
+    Q_EMIT previewLoadedChanged();
+    update();
+}
+
+QString PanoramaViewer::getPreviewPath() const
+{
+    if (!_msfmData)
+        return QString();
+
+    const QFileInfo sfmDataFile(_msfmData->sfmDataPath().toLocalFile());
+    if (sfmDataFile.fileName().isEmpty())
+        return QString();
+    return sfmDataFile.absoluteDir().filePath(sfmDataFile.completeBaseName() + previewSuffix);
+}
+
+std::string PanoramaViewer::getPreviewKey() const
+{
+    std::string key = std::to_string(_tileSize) + " " + std::to_string(_atlasColumns);
+    for (const CompositeView& compositeView : _composite)
+        key += " " + std::to_string(compositeView.viewId);
+    return key;
+}
+
+void PanoramaViewer::onTileLoaded(int requestId, int index, int resolution, std::shared_ptr<FloatImage> tile)
+{
+    // Ignore results of outdated loadings
+    if (requestId != _compositeRequestId->loadAcquire() || index < 0 || static_cast<std::size_t>(index) >= _composite.size())
+        return;
+
+    // Ignore tiles arriving after a tile at a higher resolution
+    CompositeView& compositeView = _composite[static_cast<std::size_t>(index)];
+    if (compositeView.tileDone || (tile && resolution <= compositeView.tileResolution))
+        return;
+
+    // Failed views are not reloaded, and views at the resolution of the atlas do not need to be
+    if (!tile || resolution >= getTileResolution(compositeView.imageSize, 0, _tileSize))
+    {
+        compositeView.tileDone = true;
+        --_pendingTileCount;
+        if (!tile)
+            ++_failedTileCount;
+    }
+
+    // Once all the tiles have been loaded at the resolution of the atlas, it is saved as a preview for the next openings.
+    // It is not saved if some of them could not be loaded: the missing views would be reused until the SfMData changes.
+    if (compositeView.tileDone && _pendingTileCount == 0 && _persistPreview && !getPreviewPath().isEmpty())
+    {
+        if (_failedTileCount == 0)
+        {
+            _savePreview = true;
+            update();
+        }
+        else
+        {
+            qWarning() << "[QtAliceVision] PANORAMA: preview not saved," << _failedTileCount << "views could not be loaded";
+        }
+    }
+
+    if (!tile)
+        return;
+
+    // Copied in the atlas on the next synchronization with the render thread
+    compositeView.pendingTile = tile;
+    compositeView.tileResolution = resolution;
+    compositeView.tileReady = true;
+    _atlasChanged = true;
+    _compositeGeometryChanged |= compositeView.meshReady;
+    update();
 }
 
-PanoramaViewer::~PanoramaViewer() {}
+void PanoramaViewer::onMeshComputed(int requestId, int index, SurfaceVerticesData data)
+{
+    // Ignore results of outdated computations
+    if (requestId != _compositeRequestId->loadAcquire() || index < 0 || static_cast<std::size_t>(index) >= _composite.size())
+        return;
+
+    CompositeView& compositeView = _composite[static_cast<std::size_t>(index)];
+    compositeView.vertices = std::move(data.vertices);
+    compositeView.sphereCoordinates = std::move(data.sphereCoordinates);
+    compositeView.center = data.center;
+    compositeView.radius = data.radius;
+    compositeView.meshReady = true;
+    _compositeGeometryChanged |= compositeView.tileReady;
+    update();
+}
+
+Eigen::Matrix3d PanoramaViewer::getPanoramaRotation() const
+{
+    return computePanoramaRotation(aliceVision::degreeToRadian(_yaw), aliceVision::degreeToRadian(_pitch), aliceVision::degreeToRadian(_roll));
+}
 
 void PanoramaViewer::computeDownscale()
 {
@@ -59,9 +588,237 @@ QSGNode* PanoramaViewer::updatePaintNode(QSGNode* oldNode, QQuickItem::UpdatePai
 {
     (void)data;  // Fix "unused parameter" warnings; should be replaced by [[maybe_unused]] when C++17 is supported
     QSGGeometryNode* root = static_cast<QSGGeometryNode*>(oldNode);
+
+    if (!_compositeViews || !_atlas)
+    {
+        delete root;
+        return nullptr;
+    }
+
+    QSGSimpleMaterial<PanoramaShaderData>* material = nullptr;
+    if (!root)
+    {
+        root = new QSGGeometryNode;
+        auto geometry = new QSGGeometry(panoramaVertexAttributes(), 0, 0, QSGGeometry::UnsignedIntType);
+        geometry->setDrawingMode(GL_TRIANGLES);
+        geometry->setIndexDataPattern(QSGGeometry::StaticPattern);
+        geometry->setVertexDataPattern(QSGGeometry::StaticPattern);
+        root->setGeometry(geometry);
+        root->setFlags(QSGNode::OwnsGeometry);
+
+        material = PanoramaViewerShader::createMaterial();
+        // Premultiplied alpha: the borders of the views are blended with the overlapping views
+        material->setFlag(QSGMaterial::Blending, true);
+        auto texture = std::make_shared<FloatTexture>();
+        texture->setFiltering(QSGTexture::Linear);
+        texture->setHorizontalWrapMode(QSGTexture::ClampToEdge);
+        texture->setVerticalWrapMode(QSGTexture::ClampToEdge);
+        material->state()->texture = texture;
+        root->setMaterial(material);
+        root->setFlags(QSGNode::OwnsMaterial);
+
+        _atlasChanged = true;
+        _atlasReset = true;
+        _compositeGeometryChanged = true;
+    }
+    else
+    {
+        material = static_cast<QSGSimpleMaterial<PanoramaShaderData>*>(root->material());
+    }
+
+    // The render thread does not use the atlas during the synchronization: copy the new tiles in it
+    if (_atlasChanged)
+    {
+        _atlasChanged = false;
+        auto texture = std::static_pointer_cast<FloatTexture>(material->state()->texture);
+        if (_pendingPreview)
+        {
+            *_atlas = *_pendingPreview;
+            _pendingPreview.reset();
+            _atlasReset = true;
+        }
+        if (_atlasReset)
+        {
+            _atlasReset = false;
+            texture->setImage(_atlas);
+        }
+        for (std::size_t i = 0; i < _composite.size(); ++i)
+        {
+            std::shared_ptr<FloatImage> tile = std::move(_composite[i].pendingTile);
+            if (!tile)
+                continue;
+
+            const int tileX = static_cast<int>(i) % _atlasColumns * _tileSize;
+            const int tileY = static_cast<int>(i) / _atlasColumns * _tileSize;
+            _atlas->block(tileY, tileX, _tileSize, _tileSize) = *tile;
+            // Only the new tiles are uploaded
+            texture->updateRegion(QRect(tileX, tileY, _tileSize, _tileSize));
+        }
+        root->markDirty(QSGNode::DirtyMaterial);
+    }
+
+    // All the tiles have been copied in the atlas: save a copy of it in the background
+    if (_savePreview)
+    {
+        _savePreview = false;
+        QThreadPool::globalInstance()->start(
+          new PanoramaPreviewWriteRunnable(getPreviewPath().toStdString(), getPreviewKey(), std::make_shared<const FloatImage>(*_atlas)));
+    }
+
+    if (_compositeGeometryChanged)
+    {
+        _compositeGeometryChanged = false;
+
+        const int gridSize = compositeSubdivisions + 1;
+        const int vertexCountPerView = gridSize * gridSize;
+        const int indexCountPerView = compositeSubdivisions * compositeSubdivisions * 6;
+
+        int viewCount = 0;
+        for (const CompositeView& compositeView : _composite)
+        {
+            if (compositeView.meshReady && compositeView.tileReady && compositeView.vertices.size() == static_cast<std::size_t>(vertexCountPerView))
+                ++viewCount;
+        }
+
+        // The second half of the geometry is a copy of the meshes drawn across the seam (see the vertex shader)
+        const int vertexCount = viewCount * vertexCountPerView;
+        const int indexCount = viewCount * indexCountPerView;
+        QSGGeometry* geometry = root->geometry();
+        geometry->allocate(2 * vertexCount, 2 * indexCount);
+        auto* vertices = static_cast<PanoramaVertex*>(geometry->vertexData());
+        quint32* indices = geometry->indexDataAsUInt();
+
+        const float tileScale = 1.f / static_cast<float>(_atlasColumns);
+        _compositeGeometryViews.clear();
+        for (std::size_t i = 0; i < _composite.size(); ++i)
+        {
+            const CompositeView& compositeView = _composite[i];
+            if (!compositeView.meshReady || !compositeView.tileReady || compositeView.vertices.size() != static_cast<std::size_t>(vertexCountPerView))
+                continue;
+            _compositeGeometryViews.push_back(i);
+
+            const float tileU = static_cast<float>(static_cast<int>(i) % _atlasColumns) * tileScale;
+            const float tileV = static_cast<float>(static_cast<int>(i) / _atlasColumns) * tileScale;
+            for (const QSGGeometry::TexturedPoint2D& vertex : compositeView.vertices)
+            {
+                *vertices++ = {vertex.x,
+                               vertex.y,
+                               vertex.tx,
+                               vertex.ty,
+                               tileU,
+                               tileV,
+                               static_cast<float>(compositeView.center.x()),
+                               static_cast<float>(compositeView.center.y()),
+                               static_cast<float>(compositeView.center.z()),
+                               static_cast<float>(compositeView.radius)};
+            }
+        }
+
+        // Copy of the meshes, identified by their longitudes offset by 4 pi
+        std::transform(vertices - vertexCount, vertices, vertices, [](PanoramaVertex vertex) {
+            vertex.longitude += panoramaSeamCopyOffset;
+            return vertex;
+        });
+        writeCompositeIndices(indices);
+        _compositeIndicesChanged = false;
+
+        geometry->markVertexDataDirty();
+        geometry->markIndexDataDirty();
+        root->markDirty(QSGNode::DirtyGeometry);
+
+        if (_compositeViewCount != viewCount)
+        {
+            _compositeViewCount = viewCount;
+            Q_EMIT compositeViewCountChanged();
+        }
+    }
+
+    // The views containing a pole drop the cells crossing the cut of their unwrapping, which depends on the rotation.
+    // The indices of the other views do not depend on the rotation.
+    if (_compositeIndicesChanged)
+    {
+        _compositeIndicesChanged = false;
+        const Eigen::Matrix3d rotation = getPanoramaRotation();
+        const bool containsPole = std::any_of(_compositeGeometryViews.begin(), _compositeGeometryViews.end(), [&](std::size_t i) {
+            return panoramaCapContainsPole(rotation * _composite[i].center, _composite[i].radius);
+        });
+        if (containsPole || _compositeCutCells)
+        {
+            writeCompositeIndices(root->geometry()->indexDataAsUInt());
+            root->geometry()->markIndexDataDirty();
+            root->markDirty(QSGNode::DirtyGeometry);
+        }
+    }
+
+    // The panorama fills the item
+    const QSizeF panoramaSize = size().isEmpty() ? QSizeF(_sourceSize) : size();
+    const Eigen::Matrix<float, 3, 3, Eigen::RowMajor> rotation = getPanoramaRotation().cast<float>();
+
+    material->state()->gamma = _gamma;
+    material->state()->gain = _gain;
+    material->state()->feather = _feather;
+    material->state()->rotation = QMatrix3x3(rotation.data());
+    material->state()->panoramaSize = QVector2D(static_cast<float>(panoramaSize.width()), static_cast<float>(panoramaSize.height()));
+    material->state()->tileScale = 1.f / static_cast<float>(_atlasColumns);
+    material->state()->tileMargin = 0.5f / static_cast<float>(_tileSize);
+    root->markDirty(QSGNode::DirtyMaterial);
+
     return root;
 }
 
+void PanoramaViewer::writeCompositeIndices(quint32* indices)
+{
+    const int gridSize = compositeSubdivisions + 1;
+    const quint32 vertexCountPerView = static_cast<quint32>(gridSize * gridSize);
+    const std::size_t indexCountPerView = static_cast<std::size_t>(compositeSubdivisions * compositeSubdivisions * 6);
+    const Eigen::Matrix3d rotation = getPanoramaRotation();
+
+    _compositeCutCells = false;
+    quint32 firstVertex = 0;
+    quint32* viewIndices = indices;
+    for (const std::size_t i : _compositeGeometryViews)
+    {
+        // Same cell layout as the surface of a FloatImageViewer
+        quint32* cellIndices = viewIndices;
+        for (int j = 0; j < compositeSubdivisions; ++j)
+        {
+            for (int k = 0; k < compositeSubdivisions; ++k)
+            {
+                const quint32 topLeft = firstVertex + static_cast<quint32>(k * gridSize + j);
+                const quint32 topRight = topLeft + 1;
+                const quint32 bottomLeft = topLeft + static_cast<quint32>(gridSize);
+                const quint32 bottomRight = bottomLeft + 1;
+                *cellIndices++ = topLeft;
+                *cellIndices++ = bottomLeft;
+                *cellIndices++ = topRight;
+                *cellIndices++ = topRight;
+                *cellIndices++ = bottomLeft;
+                *cellIndices++ = bottomRight;
+            }
+        }
+
+        // The views containing a pole cover all the longitudes: project them to find the cells crossing the cut of their unwrapping
+        const CompositeView& compositeView = _composite[i];
+        const aliceVision::Vec3 center = rotation * compositeView.center;
+        if (panoramaCapContainsPole(center, compositeView.radius) && compositeView.sphereCoordinates.size() == vertexCountPerView)
+        {
+            const Eigen::Map<const Eigen::Matrix3Xd> sphereCoordinates(
+              compositeView.sphereCoordinates.front().data(), 3, static_cast<Eigen::Index>(compositeView.sphereCoordinates.size()));
+            Eigen::Matrix2Xd projected(2, sphereCoordinates.cols());
+            toEquirectangular(sphereCoordinates, rotation, _sourceSize.width(), _sourceSize.height(), std::atan2(center.x(), center.z()), projected);
+            dropPanoramaCutCells(projected, _sourceSize.width(), firstVertex, viewIndices, indexCountPerView);
+            _compositeCutCells = true;
+        }
+
+        viewIndices += indexCountPerView;
+        firstVertex += vertexCountPerView;
+    }
+
+    // Copy of the meshes drawn across the seam
+    const quint32 vertexCount = firstVertex;
+    std::transform(indices, viewIndices, viewIndices, [vertexCount](quint32 index) { return index + vertexCount; });
+}
+
 void PanoramaViewer::setMSfmData(MSfMData* sfmData)
 {
     if (_msfmData == sfmData)
@@ -93,4 +850,162 @@ void PanoramaViewer::setMSfmData(MSfMData* sfmData)
     }
 }
 
+PanoramaTileRunnable::PanoramaTileRunnable(const std::string& path,
+                                           int tileSize,
+                                           int level,
+                                           int index,
+                                           int requestId,
+                                           const std::shared_ptr<QAtomicInt>& latestRequestId)
+  : _path(path),
+    _tileSize(tileSize),
+    _level(level),
+    _index(index),
+    _requestId(requestId),
+    _latestRequestId(latestRequestId)
+{}
+
+void PanoramaTileRunnable::run()
+{
+    // Skip the loading if the composite has been discarded meanwhile
+    if (_latestRequestId->loadAcquire() != _requestId)
+        return;
+
+    std::shared_ptr<FloatImage> tile;
+    int resolution = 0;
+    try
+    {
+        // Only decode the coarsest mip level that has the resolution needed at the downscale level of the view.
+        // Without mip levels, the whole image is decoded anyway: the tile is built at the resolution of the atlas,
+        // so that the view never has to be decoded again.
+        FloatImage image;
+        int imageSize = 0;
+        int level = _level;
+        if (!readCoarseMipLevel(_path, level, _tileSize, image, imageSize))
+        {
+            aliceVision::image::readImage(_path, image, aliceVision::image::EImageColorSpace::LINEAR);
+            imageSize = std::min(image.width(), image.height());
+            level = 0;
+        }
+        resolution = getTileResolution(imageSize, level, _tileSize);
+
+        // Average the pixels while the image is much larger than the resolution of the tile,
+        // interpolate the rest of the way to the tile size
+        const int downscale = std::max(1, std::min(image.width(), image.height()) / resolution);
+        if (downscale > 1)
+        {
+            aliceVision::imageAlgo::resizeImage(downscale, image);
+        }
+
+        tile = std::make_shared<FloatImage>(_tileSize, _tileSize);
+        const float scaleX = static_cast<float>(image.width()) / static_cast<float>(_tileSize);
+        const float scaleY = static_cast<float>(image.height()) / static_cast<float>(_tileSize);
+        for (int y = 0; y < _tileSize; ++y)
+        {
+            const float srcY = std::clamp((static_cast<float>(y) + 0.5f) * scaleY - 0.5f, 0.f, static_cast<float>(image.height() - 1));
+            const int y0 = static_cast<int>(srcY);
+            const int y1 = std::min(y0 + 1, image.height() - 1);
+            const float fy = srcY - static_cast<float>(y0);
+            for (int x = 0; x < _tileSize; ++x)
+            {
+                const float srcX = std::clamp((static_cast<float>(x) + 0.5f) * scaleX - 0.5f, 0.f, static_cast<float>(image.width() - 1));
+                const int x0 = static_cast<int>(srcX);
+                const int x1 = std::min(x0 + 1, image.width() - 1);
+                const float fx = srcX - static_cast<float>(x0);
+
+                aliceVision::image::RGBAfColor& pixel = (*tile)(y, x);
+                for (int c = 0; c < 4; ++c)
+                {
+                    const float top = image(y0, x0)[c] * (1.f - fx) + image(y0, x1)[c] * fx;
+                    const float bottom = image(y1, x0)[c] * (1.f - fx) + image(y1, x1)[c] * fx;
+                    pixel[c] = top * (1.f - fy) + bottom * fy;
+                }
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        tile.reset();
+    }
+
+    Q_EMIT done(_requestId, _index, resolution, tile);
+}
+
+PanoramaPreviewReadRunnable::PanoramaPreviewReadRunnable(const std::string& path,
+                                                         const std::string& key,
+                                                         std::vector<std::string> imagePaths,
+                                                         int requestId,
+                                                         const std::shared_ptr<QAtomicInt>& latestRequestId)
+  : _path(path),
+    _key(key),
+    _imagePaths(std::move(imagePaths)),
+    _requestId(requestId),
+    _latestRequestId(latestRequestId)
+{}
+
+void PanoramaPreviewReadRunnable::run()
+{
+    // Skip the reading if the composite has been discarded meanwhile
+    if (_latestRequestId->loadAcquire() != _requestId)
+        return;
+
+    // The preview is outdated if one of the source images has been replaced after it was saved
+    const QDateTime previewTime = QFileInfo(QString::fromStdString(_path)).lastModified();
+    for (const std::string& imagePath : _imagePaths)
+    {
+        if (_latestRequestId->loadAcquire() != _requestId)
+            return;
+        if (QFileInfo(QString::fromStdString(imagePath)).lastModified() > previewTime)
+        {
+            Q_EMIT done(_requestId, nullptr);
+            return;
+        }
+    }
+
+    std::shared_ptr<FloatImage> preview;
+    try
+    {
+        // Only read the pixels if the preview has been saved with the same atlas layout
+        int width, height;
+        const oiio::ParamValueList metadata = aliceVision::image::readImageMetadata(_path, width, height);
+        if (metadata.get_string(previewKeyAttribute) == _key)
+        {
+            preview = std::make_shared<FloatImage>();
+            aliceVision::image::readImage(_path, *preview, aliceVision::image::EImageColorSpace::LINEAR);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        preview.reset();
+    }
+
+    Q_EMIT done(_requestId, preview);
+}
+
+PanoramaPreviewWriteRunnable::PanoramaPreviewWriteRunnable(const std::string& path, const std::string& key, std::shared_ptr<const FloatImage> atlas)
+  : _path(path),
+    _key(key),
+    _atlas(std::move(atlas))
+{}
+
+void PanoramaPreviewWriteRunnable::run()
+{
+    try
+    {
+        // Half floats are enough for a preview
+        aliceVision::image::ImageWriteOptions options;
+        options.toColorSpace(aliceVision::image::EImageColorSpace::LINEAR);
+        options.storageDataType(aliceVision::image::EStorageDataType::Half);
+
+        oiio::ParamValueList metadata;
+        metadata.attribute(previewKeyAttribute, _key);
+        aliceVision::image::writeImage(_path, *_atlas, options, metadata);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
 }  // namespace qtAliceVision
@@ -4,9 +4,11 @@
 #include "FloatTexture.hpp"
 #include "Surface.hpp"
 
+#include <QAtomicInt>
 #include <QQuickItem>
 #include <QRunnable>
 #include <QSharedPointer>
+#include <QThreadPool>
 #include <QUrl>
 #include <QVariant>
 #include <QVector4D>
@@ -17,10 +19,19 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace qtAliceVision {
 /**
  * @brief Displays a list of Float Images.
+ *
+ * When compositeViews is enabled, the views of the SfMData are rendered by this item in a single scene graph node:
+ * their downscaled images are packed in a texture atlas, their meshes in a single geometry,
+ * and their seams are blended in the shader.
+ * The tiles of the atlas follow the downscale levels of the views: off-screen views are loaded once visible,
+ * and views whose images have mip levels are loaded from the coarsest level needed, then reloaded when their level requires
+ * a higher resolution. The tile loadings run on their own thread pool, bounded by the memory budget.
+ * Otherwise, the views are expected to be displayed by one FloatImageViewer each.
  */
 class PanoramaViewer : public QQuickItem
 {
@@ -31,6 +42,34 @@ class PanoramaViewer : public QQuickItem
 
     Q_PROPERTY(int downscale MEMBER _downscale NOTIFY downscaleChanged)
 
+    Q_PROPERTY(bool compositeViews READ getCompositeViews WRITE setCompositeViews NOTIFY compositeViewsChanged)
+
+    Q_PROPERTY(float gamma MEMBER _gamma NOTIFY gammaChanged)
+
+    Q_PROPERTY(float gain MEMBER _gain NOTIFY gainChanged)
+
+    /// Fraction of the images over which their borders are blended with the overlapping images
+    Q_PROPERTY(float feather MEMBER _feather NOTIFY featherChanged)
+
+    Q_PROPERTY(double yaw MEMBER _yaw NOTIFY anglesChanged)
+    Q_PROPERTY(double pitch MEMBER _pitch NOTIFY anglesChanged)
+    Q_PROPERTY(double roll MEMBER _roll NOTIFY anglesChanged)
+
+    /// Number of views displayed in the composite
+    Q_PROPERTY(int compositeViewCount READ getCompositeViewCount NOTIFY compositeViewCountChanged)
+
+    /// Visible region of the panorama, in panorama coordinates (see sourceSize)
+    Q_PROPERTY(QRectF viewport MEMBER _viewport NOTIFY viewportChanged)
+
+    /// Size of the visible region on screen, in pixels
+    Q_PROPERTY(QSizeF viewportSize MEMBER _viewportSize NOTIFY viewportChanged)
+
+    /// Save the atlas of the composite next to the SfMData once built, and reuse it when the SfMData is opened again
+    Q_PROPERTY(bool persistPreview MEMBER _persistPreview NOTIFY persistPreviewChanged)
+
+    /// Whether the composite is displayed from a preview saved by a previous session
+    Q_PROPERTY(bool previewLoaded READ isPreviewLoaded NOTIFY previewLoadedChanged)
+
   public:
     explicit PanoramaViewer(QQuickItem* parent = nullptr);
     ~PanoramaViewer() override;
@@ -40,7 +79,29 @@ class PanoramaViewer : public QQuickItem
     MSfMData* getMSfmData() { return _msfmData; }
     void setMSfmData(MSfMData* sfmData);
 
-    Q_SLOT void msfmDataUpdate() { computeDownscale(); }
+    Q_SLOT void msfmDataUpdate()
+    {
+        computeDownscale();
+        computeViewFootprints();
+        resetComposite();
+    }
+
+    bool getCompositeViews() const { return _compositeViews; }
+    void setCompositeViews(bool composite);
+
+    int getCompositeViewCount() const { return _compositeViewCount; }
+
+    bool isPreviewLoaded() const { return _previewLoaded; }
+
+    /**
+     * @brief Downscale level at which a view should be loaded, given its footprint in the viewport.
+     *
+     * Levels are chosen so that the images are not loaded at a higher resolution than displayed,
+     * then raised until all the visible views fit in the memory budget.
+     * @param[in] viewId identifier of the view
+     * @return the downscale level of the view, -1 if the view is off-screen (it does not need to be loaded)
+     */
+    Q_INVOKABLE int viewDownscale(int viewId) const;
 
   public:
     Q_SIGNAL void sourceSizeChanged();
@@ -51,18 +112,301 @@ class PanoramaViewer : public QQuickItem
 
     Q_SIGNAL void downscaleReady();
 
+    Q_SIGNAL void compositeViewsChanged();
+
+    Q_SIGNAL void gammaChanged();
+
+    Q_SIGNAL void gainChanged();
+
+    Q_SIGNAL void featherChanged();
+
+    Q_SIGNAL void anglesChanged();
+
+    Q_SIGNAL void compositeViewCountChanged();
+
+    Q_SIGNAL void viewportChanged();
+
+    Q_SIGNAL void persistPreviewChanged();
+
+    Q_SIGNAL void previewLoadedChanged();
+
+    /// Emitted when the downscale levels of the views have been updated (see viewDownscale)
+    Q_SIGNAL void viewDownscalesChanged();
+
   private:
     /// Custom QSGNode update
     QSGNode* updatePaintNode(QSGNode* oldNode, QQuickItem::UpdatePaintNodeData* data) override;
 
     void computeDownscale();
 
+    /// Discard the composite and, if enabled, start loading the views of the SfMData
+    void resetComposite();
+
+    /**
+     * @brief Slot called when the tile of a view has been loaded.
+     * @param[in] requestId identifier of the composite the tile was loaded for
+     * @param[in] index index of the view in the composite
+     * @param[in] resolution resolution of the tile before its interpolation to the tile size
+     * @param[in] tile downscaled image of the view
+     */
+    void onTileLoaded(int requestId, int index, int resolution, std::shared_ptr<FloatImage> tile);
+
+    /**
+     * @brief Slot called when the mesh of a view has been computed.
+     * @param[in] requestId identifier of the composite the mesh was computed for
+     * @param[in] index index of the view in the composite
+     * @param[in] data vertices of the view on the unit sphere
+     */
+    void onMeshComputed(int requestId, int index, SurfaceVerticesData data);
+
+    /// Start loading the tiles of the views of the composite from the source images
+    void loadCompositeTiles(int requestId);
+
+    /// Load the tiles of the views that became visible or need a higher resolution at their current downscale level
+    void updateCompositeTiles();
+
+    /**
+     * @brief Slot called when the preview saved next to the SfMData has been read.
+     * @param[in] requestId identifier of the composite the preview was read for
+     * @param[in] preview atlas of the composite, null if the preview does not match the composite
+     */
+    void onPreviewLoaded(int requestId, std::shared_ptr<FloatImage> preview);
+
+    /// Filepath of the preview of the composite, next to the SfMData file (empty if the SfMData has no file)
+    QString getPreviewPath() const;
+
+    /// Identifies the layout of the atlas: a saved preview is only reused if it has the same key
+    std::string getPreviewKey() const;
+
+    /// Rotation matrix of the panorama from the yaw, pitch and roll angles
+    Eigen::Matrix3d getPanoramaRotation() const;
+
+    /**
+     * @brief Write the indices of the views of the composite geometry, followed by those of the copy of their meshes.
+     * The cells of the views containing a pole that cross the cut of their unwrapping are dropped.
+     * @param[out] indices index data of the composite geometry
+     */
+    void writeCompositeIndices(quint32* indices);
+
+    /// Whether the visible region of the panorama is known
+    bool hasViewport() const;
+
+    /// Sample the directions covered by each view of the SfMData on the unit sphere
+    void computeViewFootprints();
+
+    /// Choose the downscale level of each view from its footprint in the viewport and the memory budget
+    void updateViewDownscales();
+
   private:
+    /// Directions covered by a view on the unit sphere, used to estimate its footprint in the panorama
+    struct ViewFootprint
+    {
+        aliceVision::IndexT viewId;
+        int imageWidth;
+        int imageHeight;
+        /// Directions of a few points of the image (one per column)
+        Eigen::Matrix3Xd samples;
+        /// Direction of the center of the image
+        aliceVision::Vec3 center;
+    };
+
+    /// View displayed in the composite
+    struct CompositeView
+    {
+        aliceVision::IndexT viewId = aliceVision::UndefinedIndexT;
+
+        /// Longitude and latitude on the unit sphere, and texture coordinates of the mesh vertices
+        std::vector<QSGGeometry::TexturedPoint2D> vertices;
+
+        /// Directions of the mesh vertices on the unit sphere, to find the cells crossing the cut of the unwrapping
+        std::vector<aliceVision::Vec3> sphereCoordinates;
+
+        /// Direction of the center of the image on the unit sphere
+        aliceVision::Vec3 center = aliceVision::Vec3(0.0, 0.0, 1.0);
+
+        /// Largest angle between the center of the image and its vertices on the unit sphere
+        double radius = M_PI;
+
+        /// Tile waiting to be copied in the atlas
+        std::shared_ptr<FloatImage> pendingTile;
+
+        /// Smallest dimension of the source image, in pixels
+        int imageSize = 0;
+        /// Finest downscale level requested for the tile, -1 if it has not been requested yet
+        int tileLevel = -1;
+        /// Resolution of the tile in the atlas before its interpolation to the tile size, 0 if not loaded yet
+        int tileResolution = 0;
+
+        bool meshReady = false;
+        bool tileReady = false;
+        /// The tile is at the resolution of the atlas or could not be loaded: it is not reloaded anymore
+        bool tileDone = false;
+    };
+
     QSize _sourceSize = QSize(3000, 1500);
 
+    QRectF _viewport;
+    QSizeF _viewportSize;
+
+    std::vector<ViewFootprint> _footprints;
+    /// Downscale level of each view, -1 if off-screen
+    std::map<aliceVision::IndexT, int> _viewDownscales;
+    /// Memory available for the visible views, in bytes, read once per SfMData
+    double _memoryBudget = 0.0;
+
     MSfMData* _msfmData = nullptr;
 
     int _downscale = 4;
+
+    bool _compositeViews = false;
+    float _gamma = 1.f;
+    float _gain = 1.f;
+    float _feather = 0.1f;
+    double _yaw = 0.0;
+    double _pitch = 0.0;
+    double _roll = 0.0;
+
+    std::vector<CompositeView> _composite;
+    /// Indices in the composite of the views in the geometry, in order
+    std::vector<std::size_t> _compositeGeometryViews;
+    int _compositeViewCount = 0;
+
+    /// Source images downscaled to square tiles, all packed in a single texture
+    std::shared_ptr<FloatImage> _atlas;
+    int _atlasColumns = 1;
+    int _tileSize = 0;
+
+    bool _atlasChanged = false;
+    /// The whole atlas needs to be uploaded, otherwise only the new tiles are
+    bool _atlasReset = false;
+    bool _compositeGeometryChanged = false;
+    /// The rotation has changed: the indices of the views containing a pole need to be updated
+    bool _compositeIndicesChanged = false;
+    /// Some cells have been dropped from the indices
+    bool _compositeCutCells = false;
+
+    bool _persistPreview = false;
+    bool _previewLoaded = false;
+    /// The tiles are loaded from the source images, no preview is being read or has been loaded
+    bool _loadTiles = false;
+    /// Number of tiles still to be loaded before the atlas can be saved as a preview
+    int _pendingTileCount = 0;
+    /// Number of tiles that could not be loaded, the atlas is not saved as a preview if there are any
+    int _failedTileCount = 0;
+    bool _savePreview = false;
+    /// Preview waiting to be copied in the atlas
+    std::shared_ptr<FloatImage> _pendingPreview;
+
+    /// Identifier of the current composite, shared with the worker threads to abort outdated loadings
+    std::shared_ptr<QAtomicInt> _compositeRequestId = std::make_shared<QAtomicInt>(0);
+
+    /// Threadpool of the tile loadings, limited to the number of source images fitting in the memory budget
+    QThreadPool _tilePool;
+};
+
+/**
+ * @brief QRunnable object dedicated to loading the image of a view downscaled to a square tile of the panorama atlas.
+ */
+class PanoramaTileRunnable : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+  public:
+    /**
+     * @param[in] path filepath of the image to load
+     * @param[in] tileSize size of the tile in pixels
+     * @param[in] level downscale level of the view, only used to choose the mip level of the images that have some
+     * @param[in] index index of the view in the composite
+     * @param[in] requestId identifier of the composite
+     * @param[in] latestRequestId identifier of the latest composite, used to skip outdated loadings
+     */
+    PanoramaTileRunnable(const std::string& path,
+                         int tileSize,
+                         int level,
+                         int index,
+                         int requestId,
+                         const std::shared_ptr<QAtomicInt>& latestRequestId);
+
+    /// Load the tile in a worker thread
+    Q_SLOT void run() override;
+
+    /**
+     * @brief Signal emitted when the tile has been loaded.
+     * @param[in] requestId identifier of the composite
+     * @param[in] index index of the view in the composite
+     * @param[in] resolution resolution of the tile before its interpolation to the tile size
+     * @param[in] tile downscaled image of the view
+     */
+    Q_SIGNAL void done(int requestId, int index, int resolution, std::shared_ptr<FloatImage> tile);
+
+  private:
+    std::string _path;
+    int _tileSize;
+    int _level;
+    int _index;
+    int _requestId;
+    std::shared_ptr<QAtomicInt> _latestRequestId;
+};
+
+/**
+ * @brief QRunnable object dedicated to reading the preview of a composite saved next to the SfMData.
+ */
+class PanoramaPreviewReadRunnable : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+  public:
+    /**
+     * @param[in] path filepath of the preview
+     * @param[in] key layout of the atlas of the composite, the preview is discarded if it has been saved with another layout
+     * @param[in] imagePaths filepaths of the source images, the preview is discarded if one of them is newer
+     * @param[in] requestId identifier of the composite
+     * @param[in] latestRequestId identifier of the latest composite, used to skip outdated readings
+     */
+    PanoramaPreviewReadRunnable(const std::string& path,
+                                const std::string& key,
+                                std::vector<std::string> imagePaths,
+                                int requestId,
+                                const std::shared_ptr<QAtomicInt>& latestRequestId);
+
+    /// Read the preview in a worker thread
+    Q_SLOT void run() override;
+
+    /**
+     * @brief Signal emitted when the preview has been read.
+     * @param[in] requestId identifier of the composite
+     * @param[in] preview atlas of the composite, null if the preview does not match the composite or could not be read
+     */
+    Q_SIGNAL void done(int requestId, std::shared_ptr<FloatImage> preview);
+
+  private:
+    std::string _path;
+    std::string _key;
+    std::vector<std::string> _imagePaths;
+    int _requestId;
+    std::shared_ptr<QAtomicInt> _latestRequestId;
+};
+
+/**
+ * @brief QRunnable object dedicated to saving the atlas of a composite as a preview next to the SfMData.
+ */
+class PanoramaPreviewWriteRunnable : public QRunnable
+{
+  public:
+    /**
+     * @param[in] path filepath of the preview
+     * @param[in] key layout of the atlas of the composite, stored in the metadata of the preview
+     * @param[in] atlas copy of the atlas of the composite
+     */
+    PanoramaPreviewWriteRunnable(const std::string& path, const std::string& key, std::shared_ptr<const FloatImage> atlas);
+
+    /// Write the preview in a worker thread
+    void run() override;
+
+  private:
+    std::string _path;
+    std::string _key;
+    std::shared_ptr<const FloatImage> _atlas;
 };
 
 }  // namespace qtAliceVision
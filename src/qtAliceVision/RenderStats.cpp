@@ -0,0 +1,177 @@
+#include "RenderStats.hpp"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+
+namespace qtAliceVision {
+
+RenderStats::RenderStats(QObject* parent)
+  : QObject(parent)
+{}
+
+double RenderStats::getFrameTime() const
+{
+    QMutexLocker locker(&_mutex);
+    return _frameTimes.empty() ? 0.0 : _frameTimes.back();
+}
+
+double RenderStats::getMaxFrameTime() const
+{
+    QMutexLocker locker(&_mutex);
+    return _frameTimes.empty() ? 0.0 : *std::max_element(_frameTimes.begin(), _frameTimes.end());
+}
+
+QVariantList RenderStats::getFrameTimes() const
+{
+    QMutexLocker locker(&_mutex);
+    QVariantList frameTimes;
+    for (const double frameTime : _frameTimes)
+        frameTimes.append(frameTime);
+    return frameTimes;
+}
+
+double RenderStats::getSyncTime() const
+{
+    QMutexLocker locker(&_mutex);
+    return _syncTime;
+}
+
+double RenderStats::getDecodeTime() const
+{
+    QMutexLocker locker(&_mutex);
+    return _decodeTime;
+}
+
+double RenderStats::getResizeTime() const
+{
+    QMutexLocker locker(&_mutex);
+    return _resizeTime;
+}
+
+double RenderStats::getUploadTime() const
+{
+    QMutexLocker locker(&_mutex);
+    return _uploadTime;
+}
+
+double RenderStats::getGeometryTime() const
+{
+    QMutexLocker locker(&_mutex);
+    return _geometryTime;
+}
+
+int RenderStats::getUploads() const
+{
+    QMutexLocker locker(&_mutex);
+    return _uploads;
+}
+
+int RenderStats::getCacheHits() const
+{
+    QMutexLocker locker(&_mutex);
+    return _cacheHits;
+}
+
+int RenderStats::getCacheMisses() const
+{
+    QMutexLocker locker(&_mutex);
+    return _cacheMisses;
+}
+
+std::vector<double> RenderStats::frameTimeHistory() const
+{
+    QMutexLocker locker(&_mutex);
+    return std::vector<double>(_frameTimes.begin(), _frameTimes.end());
+}
+
+void RenderStats::addFrame(double syncTime)
+{
+    {
+        QMutexLocker locker(&_mutex);
+        const Clock::time_point now = Clock::now();
+        if (_hasLastFrame)
+        {
+            _frameTimes.push_back(std::chrono::duration<double, std::milli>(now - _lastFrame).count());
+            if (_frameTimes.size() > historySize)
+                _frameTimes.pop_front();
+        }
+        _lastFrame = now;
+        _hasLastFrame = true;
+        _syncTime = syncTime;
+    }
+    notify();
+}
+
+void RenderStats::addDecode(double decodeTime, double resizeTime)
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _decodeTime = decodeTime;
+        _resizeTime = resizeTime;
+    }
+    notify();
+}
+
+void RenderStats::addCacheAccess(bool hit)
+{
+    {
+        QMutexLocker locker(&_mutex);
+        ++(hit ? _cacheHits : _cacheMisses);
+    }
+    notify();
+}
+
+void RenderStats::addUpload(double uploadTime)
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _uploadTime = uploadTime;
+        ++_uploads;
+    }
+    notify();
+}
+
+void RenderStats::addGeometry(double geometryTime)
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _geometryTime = geometryTime;
+    }
+    notify();
+}
+
+void RenderStats::reset()
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _hasLastFrame = false;
+        _frameTimes.clear();
+        _syncTime = 0.0;
+        _decodeTime = 0.0;
+        _resizeTime = 0.0;
+        _uploadTime = 0.0;
+        _geometryTime = 0.0;
+        _uploads = 0;
+        _cacheHits = 0;
+        _cacheMisses = 0;
+    }
+    notify();
+}
+
+void RenderStats::notify()
+{
+    // Counters are updated several times per frame: only emit once the event loop of the owner thread is reached
+    if (_notifyPending.exchange(true))
+        return;
+
+    QMetaObject::invokeMethod(
+      this,
+      [this]() {
+          _notifyPending = false;
+          Q_EMIT statsChanged();
+      },
+      Qt::QueuedConnection);
+}
+
+}  // namespace qtAliceVision
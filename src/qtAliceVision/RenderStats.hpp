@@ -0,0 +1,132 @@
+#pragma once
+
+#include <QMutex>
+#include <QObject>
+#include <QVariant>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+namespace qtAliceVision {
+
+/**
+ * @brief Timing counters of the loading and rendering of a FloatImageViewer.
+ *
+ * Counters are fed from the GUI thread (image server requests) and from the render thread
+ * (paint node synchronization, texture uploads, geometry rebuilds), hence every access is guarded by a mutex.
+ * The statsChanged signal is always delivered on the thread owning this object, at most once per event loop iteration.
+ *
+ * Durations are expressed in milliseconds. Durations that were not measured yet are 0.
+ */
+class RenderStats : public QObject
+{
+    Q_OBJECT
+
+    /// Time elapsed between the last two synchronizations of the viewer with the render thread
+    Q_PROPERTY(double frameTime READ getFrameTime NOTIFY statsChanged)
+    /// Largest frame time of the history
+    Q_PROPERTY(double maxFrameTime READ getMaxFrameTime NOTIFY statsChanged)
+    /// Frame times of the latest frames, oldest first
+    Q_PROPERTY(QVariantList frameTimes READ getFrameTimes NOTIFY statsChanged)
+    /// Time spent updating the paint node of the viewer, uploads and geometry rebuilds included
+    Q_PROPERTY(double syncTime READ getSyncTime NOTIFY statsChanged)
+    /// Time spent decoding the latest loaded image
+    Q_PROPERTY(double decodeTime READ getDecodeTime NOTIFY statsChanged)
+    /// Time spent resizing the latest loaded image to the requested downscale
+    Q_PROPERTY(double resizeTime READ getResizeTime NOTIFY statsChanged)
+    /// Time spent uploading the latest texture, float to half conversion included
+    Q_PROPERTY(double uploadTime READ getUploadTime NOTIFY statsChanged)
+    /// Time spent rebuilding the latest surface geometry
+    Q_PROPERTY(double geometryTime READ getGeometryTime NOTIFY statsChanged)
+    /// Number of texture uploads
+    Q_PROPERTY(int uploads READ getUploads NOTIFY statsChanged)
+    /// Number of requested images that were already in memory
+    Q_PROPERTY(int cacheHits READ getCacheHits NOTIFY statsChanged)
+    /// Number of requested images that had to be loaded
+    Q_PROPERTY(int cacheMisses READ getCacheMisses NOTIFY statsChanged)
+
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Number of frames kept in the frame time history
+    static constexpr std::size_t historySize = 120;
+
+    explicit RenderStats(QObject* parent = nullptr);
+
+    /// Duration elapsed since a given time point, in milliseconds
+    static double elapsedMs(const Clock::time_point& start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    double getFrameTime() const;
+    double getMaxFrameTime() const;
+    QVariantList getFrameTimes() const;
+    double getSyncTime() const;
+    double getDecodeTime() const;
+    double getResizeTime() const;
+    double getUploadTime() const;
+    double getGeometryTime() const;
+    int getUploads() const;
+    int getCacheHits() const;
+    int getCacheMisses() const;
+
+    /// Frame times of the latest frames, oldest first
+    std::vector<double> frameTimeHistory() const;
+
+    /**
+     * @brief Record a synchronization of the viewer with the render thread.
+     * @param[in] syncTime time spent updating the paint node
+     */
+    void addFrame(double syncTime);
+
+    /**
+     * @brief Record the loading of an image.
+     * @param[in] decodeTime time spent decoding the image
+     * @param[in] resizeTime time spent resizing the image
+     */
+    void addDecode(double decodeTime, double resizeTime);
+
+    /**
+     * @brief Record an image request.
+     * @param[in] hit whether the image was already in memory
+     */
+    void addCacheAccess(bool hit);
+
+    /// Record a texture upload
+    void addUpload(double uploadTime);
+
+    /// Record a surface geometry rebuild
+    void addGeometry(double geometryTime);
+
+    /// Reset all the counters
+    Q_INVOKABLE void reset();
+
+    Q_SIGNAL void statsChanged();
+
+  private:
+    /// Schedule the emission of statsChanged on the thread owning this object
+    void notify();
+
+  private:
+    mutable QMutex _mutex;
+
+    Clock::time_point _lastFrame;
+    bool _hasLastFrame = false;
+    std::deque<double> _frameTimes;
+
+    double _syncTime = 0.0;
+    double _decodeTime = 0.0;
+    double _resizeTime = 0.0;
+    double _uploadTime = 0.0;
+    double _geometryTime = 0.0;
+    int _uploads = 0;
+    int _cacheHits = 0;
+    int _cacheMisses = 0;
+
+    std::atomic<bool> _notifyPending{false};
+};
+
+}  // namespace qtAliceVision
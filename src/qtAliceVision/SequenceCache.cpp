@@ -222,6 +222,35 @@ QPointF SequenceCache::getRamInfo() const
     return QPointF(static_cast<int>(memInfo.availableRam / (1024. * 1024. * 1024.)), _cache->info().contentSize / (1024. * 1024. * 1024. * 1024.));
 }
 
+std::vector<std::shared_ptr<aliceVision::image::Image<aliceVision::image::RGBAfColor>>> SequenceCache::getCachedImages(const std::string& path,
+                                                                                                                  int count) const
+{
+    std::vector<std::shared_ptr<aliceVision::image::Image<aliceVision::image::RGBAfColor>>> images;
+
+    const int frame = getFrame(path);
+    if (frame < 0)
+    {
+        return images;
+    }
+
+    const int lastFrame = std::min(frame + count, static_cast<int>(_sequence.size()));
+    for (int f = frame; f < lastFrame; ++f)
+    {
+        const FrameData& data = _sequence[static_cast<std::size_t>(f)];
+
+        // Only retrieve images that are already in cache
+        const bool cachedOnly = true;
+        const bool lazyCleaning = false;
+        auto img = _cache->get<aliceVision::image::RGBAfColor>(data.path, data.downscale, cachedOnly, lazyCleaning);
+        if (img)
+        {
+            images.push_back(img);
+        }
+    }
+
+    return images;
+}
+
 ResponseData SequenceCache::request(const RequestData& reqData)
 {
     // Initialize empty response
@@ -264,7 +293,11 @@ ResponseData SequenceCache::request(const RequestData& reqData)
         {
             const bool cachedOnly = false;
             const bool lazyCleaning = false;
+            auto tLoad = std::chrono::steady_clock::now();
             response.img = _cache->get<aliceVision::image::RGBAfColor>(data.path, data.downscale, cachedOnly, lazyCleaning);
+
+            // The image cache decodes and resizes in a single call
+            response.decodeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tLoad).count();
         }
         catch (const std::runtime_error& e)
         {
@@ -109,6 +109,22 @@ class SequenceCache : public QObject, public ImageServer
      */
     QPointF getRamInfo() const;
 
+    /**
+     * @brief Check if an image is part of the sequence.
+     * @param[in] path filepath of an image
+     * @return true if the image belongs to the sequence
+     */
+    bool contains(const std::string& path) const { return getFrame(path) >= 0; }
+
+    /**
+     * @brief Retrieve the images of the frames following an image in the sequence, if they are already cached.
+     * @param[in] path filepath of an image in the sequence
+     * @param[in] count number of frames to retrieve, starting from the frame of the given image (included)
+     * @return the cached images, in sequence order (frames that are not cached are skipped)
+     * @note this method never loads images from disk
+     */
+    std::vector<std::shared_ptr<aliceVision::image::Image<aliceVision::image::RGBAfColor>>> getCachedImages(const std::string& path, int count) const;
+
   public:
     // Request management
 
@@ -1,13 +1,24 @@
 #pragma once
 
+#include "LutTexture.hpp"
+#include "PanoramaProjection.hpp"
+#include "StMapTexture.hpp"
+
 #include <memory>
 
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
 #include <QSGGeometry>
 #include <QSGGeometryNode>
 #include <QSGSimpleMaterial>
 #include <QSGSimpleMaterialShader>
 #include <QSGTexture>
 
+#include <QByteArray>
+#include <QGenericMatrix>
+#include <QVector2D>
+#include <QVector4D>
+
 namespace qtAliceVision {
 namespace {
 struct ShaderData
@@ -18,7 +29,29 @@ struct ShaderData
     float fisheyeCircleRadius = 0.f;
     float aspectRatio = 0.f;
     QVector4D channelOrder = QVector4D(0, 1, 2, 3);
-    std::unique_ptr<QSGTexture> texture;
+    std::shared_ptr<QSGTexture> texture;
+    // A/B comparison: 0 disabled, 1 wipe, 2 difference, 3 onion skin
+    float compareMode = 0.f;
+    // Wipe position in texture coordinates or onion skin opacity of the compared image
+    float compareValue = 0.5f;
+    std::shared_ptr<QSGTexture> textureB;
+    // Display transform LUT, replaces the default 2.2 gamma when set
+    std::unique_ptr<LutTexture> lut;
+    QVector3D lutDomainMin = QVector3D(0, 0, 0);
+    QVector3D lutInvDomainRange = QVector3D(1, 1, 1);
+    float lutSize = 0.f;
+    // Exposure diagnostic: 0 disabled, 1 false color, 2 clipping, 3 zebra
+    float diagnosticMode = 0.f;
+    // Scene-linear value above which pixels are flagged as clipped (clipping) or striped (zebra)
+    float diagnosticThreshold = 1.f;
+    // Undistortion map, the image is sampled at the texture coordinates it stores when set
+    std::unique_ptr<StMapTexture> stMap;
+    // Panorama: the vertices hold longitudes and latitudes on the unit sphere, rotated and projected in the vertex shader
+    float panorama = 0.f;
+    QMatrix3x3 panoramaRotation;
+    QVector2D panoramaSize = QVector2D(1, 1);
+    // Direction of the center of the image on the unit sphere and largest angle between it and the vertices (see PanoramaProjection.hpp)
+    QVector4D panoramaCenter = QVector4D(0, 0, 1, static_cast<float>(M_PI));
 };
 
 class ImageViewerShader : public QSGSimpleMaterialShader<ShaderData>
@@ -28,36 +61,111 @@ class ImageViewerShader : public QSGSimpleMaterialShader<ShaderData>
   public:
     const char* vertexShader() const override
     {
-        return "attribute highp vec4 vertex;               \n"
-               "attribute highp vec2 texCoord;             \n"
-               "uniform highp mat4 qt_Matrix;              \n"
-               "varying highp vec2 vTexCoord;              \n"
-               "void main() {                              \n"
-               "    gl_Position = qt_Matrix * vertex;      \n"
-               "    vTexCoord = texCoord;                  \n"
-               "}";
+        static const QByteArray source = QByteArray(panoramaProjectionShader) +
+                                         "attribute highp vec4 vertex;                                                      \n"
+                                         "attribute highp vec2 texCoord;                                                    \n"
+                                         "uniform highp mat4 qt_Matrix;                                                     \n"
+                                         "uniform float panorama;                                                           \n"
+                                         "uniform highp mat3 panoramaRotation;                                              \n"
+                                         "uniform highp vec2 panoramaSize;                                                  \n"
+                                         "uniform highp vec4 panoramaCenter;                                                \n"
+                                         "varying highp vec2 vTexCoord;                                                     \n"
+                                         "varying highp float vPanoramaX;                                                   \n"
+                                         "void main() {                                                                     \n"
+                                         "    highp vec4 position = vertex;                                                 \n"
+                                         "    // vertex holds the longitude and latitude of the point on the unit sphere    \n"
+                                         "    if (panorama > 0.5)                                                           \n"
+                                         "        position.xy = projectPanoramaVertex(vertex.xy, panoramaRotation, panoramaCenter, panoramaSize); \n"
+                                         "    vPanoramaX = position.x;                                                      \n"
+                                         "    gl_Position = qt_Matrix * position;                                           \n"
+                                         "    vTexCoord = texCoord;                                                         \n"
+                                         "}";
+        return source.constData();
     }
 
     const char* fragmentShader() const override
     {
         return "uniform lowp float qt_Opacity;                                                  \n"
                "uniform highp sampler2D texture;                                                \n"
+               "uniform highp sampler2D textureB;                                               \n"
+               "uniform float compareMode;                                                      \n"
+               "uniform float compareValue;                                                     \n"
                "uniform lowp float gamma;                                                       \n"
                "uniform lowp float gain;                                                        \n"
                "uniform vec2 fisheyeCircleCoord;                                                \n"
                "uniform float fisheyeCircleRadius;                                              \n"
                "uniform float aspectRatio;                                                      \n"
                "uniform vec4 channelOrder;                                                      \n"
+               "uniform highp sampler3D lut;                                                    \n"
+               "uniform vec3 lutDomainMin;                                                      \n"
+               "uniform vec3 lutInvDomainRange;                                                 \n"
+               "uniform float lutSize;                                                          \n"
+               "uniform float diagnosticMode;                                                   \n"
+               "uniform float diagnosticThreshold;                                              \n"
+               "uniform highp sampler2D stMap;                                                  \n"
+               "uniform float useStMap;                                                         \n"
+               "uniform float panorama;                                                         \n"
+               "uniform highp vec2 panoramaSize;                                                \n"
                "varying highp vec2 vTexCoord;                                                   \n"
+               "varying highp float vPanoramaX;                                                 \n"
+               "vec3 falseColor(float luminance) {                                              \n"
+               "    // exposure in stops relative to middle grey, from -6 (purple) to +6 (red)  \n"
+               "    float t = clamp((log2(max(luminance, 1e-6) / 0.18) + 6.0) / 12.0, 0.0, 1.0); \n"
+               "    vec3 c = mix(vec3(0.4, 0.0, 0.6), vec3(0.0, 0.4, 1.0), clamp(t * 4.0, 0.0, 1.0)); \n"
+               "    c = mix(c, vec3(0.5), clamp(t * 4.0 - 1.0, 0.0, 1.0));                      \n"
+               "    c = mix(c, vec3(1.0, 0.9, 0.0), clamp(t * 4.0 - 2.0, 0.0, 1.0));            \n"
+               "    return mix(c, vec3(1.0, 0.0, 0.0), clamp(t * 4.0 - 3.0, 0.0, 1.0));         \n"
+               "}                                                                               \n"
                "void main() {                                                                   \n"
-               "    vec4 color = texture2D(texture, vTexCoord);                                 \n"
-               "    color.rgb = pow(pow((color.rgb * vec3(gain)), vec3(1.0/gamma)), vec3(1.0 / 2.2)); \n"
+               "    // the unwrapped image can go past the seam of the panorama                  \n"
+               "    if (panorama > 0.5 && (vPanoramaX < 0.0 || vPanoramaX > panoramaSize.x)) discard; \n"
+               "    highp vec2 texCoord = vTexCoord;                                            \n"
+               "    if (useStMap > 0.5) {                                                       \n"
+               "        texCoord = texture2D(stMap, vTexCoord).rg;                              \n"
+               "        if (any(lessThan(texCoord, vec2(0.0))) || any(greaterThan(texCoord, vec2(1.0)))) discard; \n"
+               "    }                                                                           \n"
+               "    vec4 color = texture2D(texture, texCoord);                                  \n"
+               "    if (compareMode > 0.5) {                                                    \n"
+               "        vec4 colorB = texture2D(textureB, texCoord);                            \n"
+               "        if (compareMode < 1.5) {                                                \n"
+               "            color = vTexCoord.x > compareValue ? colorB : color;                \n"
+               "        } else if (compareMode < 2.5) {                                         \n"
+               "            color = vec4(abs(color.rgb - colorB.rgb), max(color.a, colorB.a));  \n"
+               "        } else {                                                                \n"
+               "            color = mix(color, colorB, compareValue);                           \n"
+               "        }                                                                       \n"
+               "    }                                                                           \n"
+               "    color.rgb *= vec3(gain);                                                    \n"
+               "    vec3 linearColor = color.rgb;                                               \n"
+               "    if (lutSize > 0.0) {                                                        \n"
+               "        // map the domain on the centers of the first and last LUT samples      \n"
+               "        vec3 lutCoord = clamp((color.rgb - lutDomainMin) * lutInvDomainRange, 0.0, 1.0); \n"
+               "        lutCoord = lutCoord * ((lutSize - 1.0) / lutSize) + vec3(0.5 / lutSize); \n"
+               "        color.rgb = pow(texture3D(lut, lutCoord).rgb, vec3(1.0/gamma));         \n"
+               "    } else {                                                                    \n"
+               "        color.rgb = pow(pow(color.rgb, vec3(1.0/gamma)), vec3(1.0 / 2.2));      \n"
+               "    }                                                                           \n"
+               "    if (diagnosticMode > 0.5) {                                                 \n"
+               "        // diagnostics are evaluated on the scene-linear values (gain included) \n"
+               "        float luminance = dot(linearColor, vec3(0.2126, 0.7152, 0.0722));       \n"
+               "        float maxValue = max(linearColor.r, max(linearColor.g, linearColor.b)); \n"
+               "        if (diagnosticMode < 1.5) {                                             \n"
+               "            color.rgb = falseColor(luminance);                                  \n"
+               "        } else if (diagnosticMode < 2.5) {                                      \n"
+               "            if (maxValue >= diagnosticThreshold) color.rgb = vec3(1.0, 0.0, 0.0); \n"
+               "            else if (luminance <= 0.0) color.rgb = vec3(0.0, 0.0, 1.0);         \n"
+               "        } else if (maxValue >= diagnosticThreshold) {                           \n"
+               "            // diagonal stripes of constant size on screen                      \n"
+               "            if (mod(gl_FragCoord.x + gl_FragCoord.y, 16.0) < 8.0) color.rgb = vec3(1.0); \n"
+               "            else color.rgb = vec3(0.0);                                         \n"
+               "        }                                                                       \n"
+               "    }                                                                           \n"
                "    gl_FragColor.r = color[int(channelOrder[0])];                               \n"
                "    gl_FragColor.g = color[int(channelOrder[1])];                               \n"
                "    gl_FragColor.b = color[int(channelOrder[2])];                               \n"
                "    gl_FragColor.a = int(channelOrder[3]) == -1 ? 1.0 : color[int(channelOrder[3])]; \n"
                "    gl_FragColor.a *= qt_Opacity; \n"
-               "    if(distance(vec2(vTexCoord.x * aspectRatio ,vTexCoord.y), vec2(fisheyeCircleCoord.x * aspectRatio "
+               "    if(distance(vec2(texCoord.x * aspectRatio ,texCoord.y), vec2(fisheyeCircleCoord.x * aspectRatio "
                ", fisheyeCircleCoord.y)) > fisheyeCircleRadius && fisheyeCircleRadius > 0.0) {    \n"
                "       gl_FragColor.a *= 0.001;                                                  \n"
                "    }                                                                            \n"
@@ -81,6 +189,43 @@ class ImageViewerShader : public QSGSimpleMaterialShader<ShaderData>
         program()->setUniformValue(_fisheyeCircleRadiusId, data->fisheyeCircleRadius);
         program()->setUniformValue(_aspectRatio, data->aspectRatio);
 
+        program()->setUniformValue(_compareModeId, data->textureB ? data->compareMode : 0.f);
+        program()->setUniformValue(_compareValueId, data->compareValue);
+
+        program()->setUniformValue(_lutSizeId, data->lut ? data->lutSize : 0.f);
+        program()->setUniformValue(_lutDomainMinId, data->lutDomainMin);
+        program()->setUniformValue(_lutInvDomainRangeId, data->lutInvDomainRange);
+
+        program()->setUniformValue(_diagnosticModeId, data->diagnosticMode);
+        program()->setUniformValue(_diagnosticThresholdId, data->diagnosticThreshold);
+
+        program()->setUniformValue(_useStMapId, data->stMap ? 1.f : 0.f);
+
+        program()->setUniformValue(_panoramaId, data->panorama);
+        program()->setUniformValue(_panoramaRotationId, data->panoramaRotation);
+        program()->setUniformValue(_panoramaSizeId, data->panoramaSize);
+        program()->setUniformValue(_panoramaCenterId, data->panoramaCenter);
+
+        // The LUT lives on texture unit 1, the compared image on texture unit 2, the ST-map on texture unit 3
+        // and the image on texture unit 0
+        QOpenGLFunctions* funcs = QOpenGLContext::currentContext()->functions();
+        if (data->stMap)
+        {
+            funcs->glActiveTexture(GL_TEXTURE3);
+            data->stMap->bind();
+        }
+        if (data->lut)
+        {
+            funcs->glActiveTexture(GL_TEXTURE1);
+            data->lut->bind();
+        }
+        if (data->textureB)
+        {
+            funcs->glActiveTexture(GL_TEXTURE2);
+            data->textureB->bind();
+        }
+        funcs->glActiveTexture(GL_TEXTURE0);
+
         if (data->texture)
         {
             data->texture->bind();
@@ -96,9 +241,27 @@ class ImageViewerShader : public QSGSimpleMaterialShader<ShaderData>
         _fisheyeCircleRadiusId = program()->uniformLocation("fisheyeCircleRadius");
         _aspectRatio = program()->uniformLocation("aspectRatio");
         _channelOrder = program()->uniformLocation("channelOrder");
+        _textureBId = program()->uniformLocation("textureB");
+        _compareModeId = program()->uniformLocation("compareMode");
+        _compareValueId = program()->uniformLocation("compareValue");
+        _lutId = program()->uniformLocation("lut");
+        _lutSizeId = program()->uniformLocation("lutSize");
+        _lutDomainMinId = program()->uniformLocation("lutDomainMin");
+        _lutInvDomainRangeId = program()->uniformLocation("lutInvDomainRange");
+        _diagnosticModeId = program()->uniformLocation("diagnosticMode");
+        _diagnosticThresholdId = program()->uniformLocation("diagnosticThreshold");
+        _stMapId = program()->uniformLocation("stMap");
+        _useStMapId = program()->uniformLocation("useStMap");
+        _panoramaId = program()->uniformLocation("panorama");
+        _panoramaRotationId = program()->uniformLocation("panoramaRotation");
+        _panoramaSizeId = program()->uniformLocation("panoramaSize");
+        _panoramaCenterId = program()->uniformLocation("panoramaCenter");
 
-        // We will only use texture unit 0, so set it only once.
+        // Texture units never change, so set them only once.
         program()->setUniformValue(_textureId, 0);
+        program()->setUniformValue(_lutId, 1);
+        program()->setUniformValue(_textureBId, 2);
+        program()->setUniformValue(_stMapId, 3);
     }
 
   private:
@@ -109,6 +272,21 @@ class ImageViewerShader : public QSGSimpleMaterialShader<ShaderData>
     int _fisheyeCircleCoordId = -1;
     int _fisheyeCircleRadiusId = -1;
     int _aspectRatio = -1;
+    int _textureBId = -1;
+    int _compareModeId = -1;
+    int _compareValueId = -1;
+    int _lutId = -1;
+    int _lutSizeId = -1;
+    int _lutDomainMinId = -1;
+    int _lutInvDomainRangeId = -1;
+    int _diagnosticModeId = -1;
+    int _diagnosticThresholdId = -1;
+    int _stMapId = -1;
+    int _useStMapId = -1;
+    int _panoramaId = -1;
+    int _panoramaRotationId = -1;
+    int _panoramaSizeId = -1;
+    int _panoramaCenterId = -1;
 };
 
 }  // namespace
@@ -0,0 +1,183 @@
+#pragma once
+
+#include "PanoramaProjection.hpp"
+
+#include <memory>
+
+#include <QByteArray>
+#include <QGenericMatrix>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QSGGeometry>
+#include <QSGGeometryNode>
+#include <QSGSimpleMaterial>
+#include <QSGSimpleMaterialShader>
+#include <QSGTexture>
+#include <QVector2D>
+
+namespace qtAliceVision {
+namespace {
+
+/**
+ * @brief Vertex of the composited panorama.
+ *
+ * The position holds the longitude and latitude of the point on the unit sphere,
+ * rotated and projected in the equirectangular panorama by the vertex shader.
+ */
+struct PanoramaVertex
+{
+    float longitude;
+    float latitude;
+    // Texture coordinates in the source image
+    float u;
+    float v;
+    // Top-left corner of the tile of the source image in the atlas, in texture coordinates
+    float tileU;
+    float tileV;
+    // Direction of the center of the source image on the unit sphere, longitudes are unwrapped around it
+    float centerX;
+    float centerY;
+    float centerZ;
+    // Largest angle between the center and the vertices of the source image, to know if it crosses the seam of the panorama
+    float radius;
+};
+
+inline const QSGGeometry::AttributeSet& panoramaVertexAttributes()
+{
+    static const QSGGeometry::Attribute attributes[] = {
+      QSGGeometry::Attribute::createWithAttributeType(0, 2, QSGGeometry::FloatType, QSGGeometry::PositionAttribute),
+      QSGGeometry::Attribute::createWithAttributeType(1, 2, QSGGeometry::FloatType, QSGGeometry::TexCoordAttribute),
+      QSGGeometry::Attribute::createWithAttributeType(2, 2, QSGGeometry::FloatType, QSGGeometry::TexCoord1Attribute),
+      QSGGeometry::Attribute::createWithAttributeType(3, 4, QSGGeometry::FloatType, QSGGeometry::UnknownAttribute)};
+    static const QSGGeometry::AttributeSet attributeSet = {4, sizeof(PanoramaVertex), attributes};
+    return attributeSet;
+}
+
+struct PanoramaShaderData
+{
+    float gamma = 1.f;
+    float gain = 1.f;
+    // Atlas of the source images
+    std::shared_ptr<QSGTexture> texture;
+    // Size of a tile of the atlas in texture coordinates
+    float tileScale = 1.f;
+    // Half a texel of a tile, in texture coordinates of the source image
+    float tileMargin = 0.f;
+    // Fraction of the source images over which their borders are faded out to blend the seams
+    float feather = 0.1f;
+    QMatrix3x3 rotation;
+    QVector2D panoramaSize = QVector2D(1, 1);
+};
+
+class PanoramaViewerShader : public QSGSimpleMaterialShader<PanoramaShaderData>
+{
+    QSG_DECLARE_SIMPLE_SHADER(PanoramaViewerShader, PanoramaShaderData)
+
+  public:
+    const char* vertexShader() const override
+    {
+        static const QByteArray source = QByteArray(panoramaProjectionShader) +
+                                         "attribute highp vec4 vertex;                                                      \n"
+                                         "attribute highp vec2 texCoord;                                                    \n"
+                                         "attribute highp vec2 tileCoord;                                                   \n"
+                                         "attribute highp vec4 center;                                                      \n"
+                                         "uniform highp mat4 qt_Matrix;                                                     \n"
+                                         "uniform highp mat3 rotation;                                                      \n"
+                                         "uniform highp vec2 panoramaSize;                                                  \n"
+                                         "varying highp vec2 vTexCoord;                                                     \n"
+                                         "varying highp vec2 vTileCoord;                                                    \n"
+                                         "varying highp float vPanoramaX;                                                   \n"
+                                         "void main() {                                                                     \n"
+                                         "    // vertex holds the longitude and latitude of the point on the unit sphere    \n"
+                                         "    highp vec4 position = vec4(projectPanoramaVertex(vertex.xy, rotation, center, panoramaSize), 0.0, 1.0); \n"
+                                         "    vPanoramaX = position.x;                                                      \n"
+                                         "    gl_Position = qt_Matrix * position;                                           \n"
+                                         "    vTexCoord = texCoord;                                                         \n"
+                                         "    vTileCoord = tileCoord;                                                       \n"
+                                         "}";
+        return source.constData();
+    }
+
+    const char* fragmentShader() const override
+    {
+        return "uniform lowp float qt_Opacity;                                                  \n"
+               "uniform highp sampler2D texture;                                                \n"
+               "uniform lowp float gamma;                                                       \n"
+               "uniform lowp float gain;                                                        \n"
+               "uniform highp float tileScale;                                                  \n"
+               "uniform highp float tileMargin;                                                 \n"
+               "uniform highp float feather;                                                    \n"
+               "uniform highp vec2 panoramaSize;                                                \n"
+               "varying highp vec2 vTexCoord;                                                   \n"
+               "varying highp vec2 vTileCoord;                                                  \n"
+               "varying highp float vPanoramaX;                                                 \n"
+               "void main() {                                                                   \n"
+               "    // the unwrapped image can go past the seam of the panorama                  \n"
+               "    if (vPanoramaX < 0.0 || vPanoramaX > panoramaSize.x) discard;               \n"
+               "    // stay half a texel away from the tile borders, so that neighbouring tiles do not bleed \n"
+               "    highp vec2 texCoord = vTileCoord + clamp(vTexCoord, vec2(tileMargin), vec2(1.0 - tileMargin)) * tileScale; \n"
+               "    vec4 color = texture2D(texture, texCoord);                                  \n"
+               "    color.rgb *= vec3(gain);                                                    \n"
+               "    color.rgb = pow(pow(color.rgb, vec3(1.0/gamma)), vec3(1.0 / 2.2));          \n"
+               "    // fade out the borders of the image to blend the seams with the overlapping images \n"
+               "    highp vec2 border = min(vTexCoord, vec2(1.0) - vTexCoord);                  \n"
+               "    highp float weight = feather > 0.0 ? clamp(min(border.x, border.y) / feather, 0.0, 1.0) : 1.0; \n"
+               "    gl_FragColor = vec4(color.rgb, 1.0) * color.a * weight * qt_Opacity;        \n"
+               "}";
+    }
+
+    QList<QByteArray> attributes() const override
+    {
+        return QList<QByteArray>() << "vertex"
+                                   << "texCoord"
+                                   << "tileCoord"
+                                   << "center";
+    }
+
+    void updateState(const PanoramaShaderData* data, const PanoramaShaderData*) override
+    {
+        program()->setUniformValue(_gammaId, data->gamma);
+        program()->setUniformValue(_gainId, data->gain);
+        program()->setUniformValue(_tileScaleId, data->tileScale);
+        program()->setUniformValue(_tileMarginId, data->tileMargin);
+        program()->setUniformValue(_featherId, data->feather);
+        program()->setUniformValue(_rotationId, data->rotation);
+        program()->setUniformValue(_panoramaSizeId, data->panoramaSize);
+
+        QOpenGLFunctions* funcs = QOpenGLContext::currentContext()->functions();
+        funcs->glActiveTexture(GL_TEXTURE0);
+        if (data->texture)
+        {
+            data->texture->bind();
+        }
+    }
+
+    void resolveUniforms() override
+    {
+        _textureId = program()->uniformLocation("texture");
+        _gammaId = program()->uniformLocation("gamma");
+        _gainId = program()->uniformLocation("gain");
+        _tileScaleId = program()->uniformLocation("tileScale");
+        _tileMarginId = program()->uniformLocation("tileMargin");
+        _featherId = program()->uniformLocation("feather");
+        _rotationId = program()->uniformLocation("rotation");
+        _panoramaSizeId = program()->uniformLocation("panoramaSize");
+
+        // Texture units never change, so set them only once.
+        program()->setUniformValue(_textureId, 0);
+    }
+
+  private:
+    int _textureId = -1;
+    int _gammaId = -1;
+    int _gainId = -1;
+    int _tileScaleId = -1;
+    int _tileMarginId = -1;
+    int _featherId = -1;
+    int _rotationId = -1;
+    int _panoramaSizeId = -1;
+};
+
+}  // namespace
+
+}  // namespace qtAliceVision
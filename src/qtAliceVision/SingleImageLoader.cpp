@@ -2,6 +2,8 @@
 
 #include <QThreadPool>
 
+#include <algorithm>
+#include <chrono>
 #include <stdexcept>
 #include <iostream>
 
@@ -15,16 +17,28 @@ SingleImageLoader::SingleImageLoader(QObject* parent)
 {
     // Initialize internal state
     _loading = false;
+    _capacity = 1;
 }
 
 SingleImageLoader::~SingleImageLoader() {}
 
 ResponseData SingleImageLoader::request(const RequestData& reqData)
 {
-    // Check if requested image matches currently loaded image
-    if (reqData.path == _request.path && reqData.downscale == _request.downscale)
+    // Check if requested image matches a currently loaded image
+    for (auto it = _responses.begin(); it != _responses.end(); ++it)
     {
-        return _response;
+        if (reqData.path == it->first.path && reqData.downscale == it->first.downscale)
+        {
+            // Move it to the front so that it is the last one to be discarded
+            _responses.splice(_responses.begin(), _responses, it);
+            ResponseData response = _responses.front().second;
+
+            // Loading timings are only reported once
+            _responses.front().second.decodeTime = 0.0;
+            _responses.front().second.resizeTime = 0.0;
+
+            return response;
+        }
     }
 
     // If there is not already a worker thread
@@ -44,12 +58,24 @@ ResponseData SingleImageLoader::request(const RequestData& reqData)
     return ResponseData();
 }
 
+void SingleImageLoader::setCapacity(int capacity)
+{
+    _capacity = static_cast<std::size_t>(std::max(1, capacity));
+    while (_responses.size() > _capacity)
+    {
+        _responses.pop_back();
+    }
+}
+
 void SingleImageLoader::onSingleImageLoadingDone(RequestData reqData, ResponseData response)
 {
     // Update internal state
     _loading = false;
-    _request = reqData;
-    _response = response;
+    _responses.emplace_front(reqData, response);
+    while (_responses.size() > _capacity)
+    {
+        _responses.pop_back();
+    }
 
     // Notify listeners that an image has been loaded
     Q_EMIT requestHandled();
@@ -81,13 +107,17 @@ void SingleImageLoadingIORunnable::run()
         }
 
         // Load image
+        auto tDecode = std::chrono::steady_clock::now();
         response.img = std::make_shared<aliceVision::image::Image<aliceVision::image::RGBAfColor>>();
         aliceVision::image::readImage(_reqData.path, *(response.img), aliceVision::image::EImageColorSpace::LINEAR);
+        auto tResize = std::chrono::steady_clock::now();
+        response.decodeTime = std::chrono::duration<double, std::milli>(tResize - tDecode).count();
 
         // Apply downscale
         if (_reqData.downscale > 1)
         {
             aliceVision::imageAlgo::resizeImage(_reqData.downscale, *(response.img));
+            response.resizeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tResize).count();
         }
 
         // Set loading status
@@ -6,13 +6,18 @@
 #include <QRunnable>
 #include <QString>
 
+#include <list>
 #include <string>
+#include <utility>
 
 namespace qtAliceVision {
 namespace imgserve {
 
 /**
  * @brief Image server that can load a single image at a time.
+ *
+ * The responses to the most recent requests are kept (one by default, see setCapacity),
+ * so that a few clients can share this server without reloading each other's images.
  */
 class SingleImageLoader : public QObject, public ImageServer
 {
@@ -32,6 +37,12 @@ class SingleImageLoader : public QObject, public ImageServer
     /// this method will launch a worker thread to load it from disk.
     ResponseData request(const RequestData& reqData) override;
 
+    /**
+     * @brief Set the number of responses kept in memory.
+     * @param[in] capacity maximum number of responses kept (at least 1)
+     */
+    void setCapacity(int capacity);
+
     /**
      * @brief Slot called when the loading thread is done.
      * @param[in] reqData request data used to create the loading thread
@@ -47,11 +58,11 @@ class SingleImageLoader : public QObject, public ImageServer
   private:
     // Member variables
 
-    /// Latest request data.
-    RequestData _request;
+    /// Latest requests and their responses, most recent first.
+    std::list<std::pair<RequestData, ResponseData>> _responses;
 
-    /// Latest response data.
-    ResponseData _response;
+    /// Maximum number of responses kept.
+    std::size_t _capacity;
 
     /// Keep track of whether or not there is an active worker thread.
     bool _loading;
@@ -0,0 +1,62 @@
+#include "StMapTexture.hpp"
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+namespace qtAliceVision {
+
+StMapTexture::StMapTexture() {}
+
+StMapTexture::~StMapTexture()
+{
+    if (_textureId && QOpenGLContext::currentContext())
+    {
+        QOpenGLContext::currentContext()->functions()->glDeleteTextures(1, &_textureId);
+    }
+}
+
+void StMapTexture::setStMap(const std::shared_ptr<const StMap>& stMap)
+{
+    _stMap = stMap;
+    _dirty = true;
+}
+
+void StMapTexture::bind()
+{
+    QOpenGLExtraFunctions* funcs = QOpenGLContext::currentContext()->extraFunctions();
+
+    if (!_dirty)
+    {
+        funcs->glBindTexture(GL_TEXTURE_2D, _textureId);
+        return;
+    }
+
+    _dirty = false;
+
+    if (!_stMap || _stMap->size.isEmpty())
+    {
+        if (_textureId)
+        {
+            funcs->glDeleteTextures(1, &_textureId);
+        }
+        _textureId = 0;
+        return;
+    }
+
+    if (_textureId == 0)
+    {
+        funcs->glGenTextures(1, &_textureId);
+    }
+    funcs->glBindTexture(GL_TEXTURE_2D, _textureId);
+
+    // Bilinear interpolation between samples, no wrapping at the image boundaries
+    funcs->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    funcs->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    funcs->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    funcs->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Full float precision: half floats are not accurate enough to address the pixels of large images
+    funcs->glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, _stMap->size.width(), _stMap->size.height(), 0, GL_RG, GL_FLOAT, _stMap->data.data());
+}
+
+}  // namespace qtAliceVision
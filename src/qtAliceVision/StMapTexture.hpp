@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QMetaType>
+#include <QSGTexture>
+#include <QSize>
+
+#include <memory>
+#include <vector>
+
+namespace qtAliceVision {
+
+/**
+ * @brief Undistortion map (ST-map) of an intrinsic.
+ *
+ * Each sample stores the texture coordinates, in the distorted image, of the point displayed at its position.
+ * The map can have a lower resolution than the image: it is smooth and sampled with bilinear filtering.
+ */
+struct StMap
+{
+    /// Number of samples along each axis
+    QSize size;
+
+    /// Texture coordinates (u, v) of each sample, stored row by row (size.width() * size.height() * 2 floats)
+    std::vector<float> data;
+};
+
+/**
+ * @brief A QSGTexture holding an ST-map, sampled with bilinear filtering in the image shader.
+ */
+class StMapTexture : public QSGTexture
+{
+  public:
+    StMapTexture();
+    ~StMapTexture() override;
+
+    int textureId() const override { return static_cast<int>(_textureId); }
+
+    QSize textureSize() const override { return _stMap ? _stMap->size : QSize(); }
+
+    bool hasAlphaChannel() const override { return false; }
+
+    bool hasMipmaps() const override { return false; }
+
+    void setStMap(const std::shared_ptr<const StMap>& stMap);
+    const std::shared_ptr<const StMap>& stMap() const { return _stMap; }
+
+    /// Bind the texture on the current texture unit, uploading the ST-map if needed.
+    void bind() override;
+
+  private:
+    std::shared_ptr<const StMap> _stMap;
+
+    unsigned int _textureId = 0;
+
+    bool _dirty = false;
+};
+
+}  // namespace qtAliceVision
+
+Q_DECLARE_METATYPE(std::shared_ptr<const qtAliceVision::StMap>)
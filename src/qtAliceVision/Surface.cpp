@@ -9,19 +9,154 @@
 
 // Import M_PI
 #include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <limits>
 #include <memory>
 
+#include <QMutex>
+#include <QThreadPool>
+#include <QWaitCondition>
+
 namespace qtAliceVision {
 
-aliceVision::Vec2 toEquirectangular(const aliceVision::Vec3& spherical, int width, int height)
+namespace {
+
+/// Maximum distance in pixels between the distortion and its piecewise linear approximation by the grid
+constexpr double adaptiveMaxError = 0.25;
+
+/// Subdivisions at which the approximation error is measured, the error then decreases with the square of the cell size
+constexpr int adaptiveReferenceSubdivisions = 16;
+
+constexpr int adaptiveMinSubdivisions = 8;
+constexpr int adaptiveMaxSubdivisions = 512;
+
+/// Minimum size in pixels of a grid cell, finer grids do not improve the display
+constexpr int adaptiveMinCellSize = 8;
+
+/// Number of distortion meshes kept in the cache of a surface
+constexpr std::size_t meshCacheCapacity = 16;
+
+/// Number of ST-maps kept in the cache of a surface
+constexpr std::size_t stMapCacheCapacity = 4;
+
+/// Maximum size of the ST-maps, larger images use a bilinearly interpolated map
+constexpr int maxStMapSize = 2048;
+
+/**
+ * @brief QRunnable executing a function.
+ */
+class FunctionRunnable : public QRunnable
+{
+  public:
+    explicit FunctionRunnable(std::function<void()> function)
+      : _function(std::move(function))
+    {}
+
+    void run() override { _function(); }
+
+  private:
+    std::function<void()> _function;
+};
+
+/**
+ * @brief Call body(i) for each i in [0, count) using the threads of the global thread pool.
+ *
+ * The calling thread takes part in the work, so that it completes even if the thread pool is busy
+ * (e.g. when called from a thread of the pool itself).
+ * Returns once all the calls are done.
+ */
+void parallelFor(int count, const std::function<void(int)>& body)
+{
+    struct State
+    {
+        std::atomic<int> next{0};
+        std::atomic<int> done{0};
+        QMutex mutex;
+        QWaitCondition finished;
+    };
+    auto state = std::make_shared<State>();
+
+    // Helpers starting after all the work is done return immediately
+    auto work = [state, count, &body]() {
+        for (int i = state->next.fetch_add(1); i < count; i = state->next.fetch_add(1))
+        {
+            body(i);
+            if (state->done.fetch_add(1) + 1 == count)
+            {
+                QMutexLocker locker(&state->mutex);
+                state->finished.wakeAll();
+            }
+        }
+    };
+
+    QThreadPool* pool = QThreadPool::globalInstance();
+    const int nbHelpers = std::min(count, pool->maxThreadCount()) - 1;
+    for (int k = 0; k < nbHelpers; ++k)
+    {
+        pool->start(new FunctionRunnable(work));
+    }
+    work();
+
+    QMutexLocker locker(&state->mutex);
+    while (state->done.load() < count)
+    {
+        state->finished.wait(&state->mutex);
+    }
+}
+
+/**
+ * @brief Longitude and latitude of points of the unit sphere.
+ *
+ * The points are processed as a whole with Eigen array operations, so that the latitude computation is vectorised.
+ *
+ * @param[in] spherical coordinates of the points on the unit sphere (one point per column)
+ * @param[out] angles longitude and latitude of the points in radians (one point per column)
+ */
+void toLongitudeLatitude(const Eigen::Ref<const Eigen::Matrix3Xd>& spherical, Eigen::Ref<Eigen::Matrix2Xd> angles)
 {
-    const double vertical_angle = asin(spherical(1));
-    const double horizontal_angle = atan2(spherical(0), spherical(2));
+    // Clamp to avoid NaN on points that are slightly out of the unit sphere due to rounding errors
+    angles.row(1) = spherical.row(1).array().max(-1.0).min(1.0).asin().matrix();
 
-    const double latitude = ((vertical_angle + M_PI_2) / M_PI) * height;
-    const double longitude = ((horizontal_angle + M_PI) / (2.0 * M_PI)) * width;
+    // Eigen arrays do not provide atan2
+    for (Eigen::Index k = 0; k < spherical.cols(); ++k)
+    {
+        angles(0, k) = std::atan2(spherical(0, k), spherical(2, k));
+    }
+}
 
-    return aliceVision::Vec2(longitude, latitude);
+}  // namespace
+
+void toEquirectangular(const Eigen::Ref<const Eigen::Matrix3Xd>& spherical,
+                       const Eigen::Matrix3d& rotation,
+                       int width,
+                       int height,
+                       double centerLongitude,
+                       Eigen::Ref<Eigen::Matrix2Xd> panorama)
+{
+    const Eigen::Matrix3Xd rotated = rotation * spherical;
+    toLongitudeLatitude(rotated, panorama);
+
+    panorama.row(1) = ((panorama.row(1).array() + M_PI_2) * (static_cast<double>(height) / M_PI)).matrix();
+
+    const double longitudeScale = static_cast<double>(width) / (2.0 * M_PI);
+    for (Eigen::Index k = 0; k < rotated.cols(); ++k)
+    {
+        const double longitude = panorama(0, k);
+        const double unwrapped = longitude - 2.0 * M_PI * std::floor((longitude - centerLongitude + M_PI) / (2.0 * M_PI));
+        panorama(0, k) = (unwrapped + M_PI) * longitudeScale;
+    }
+}
+
+Eigen::Matrix3d computePanoramaRotation(double yaw, double pitch, double roll)
+{
+    Eigen::AngleAxis<double> Myaw(yaw, Eigen::Vector3d::UnitY());
+    Eigen::AngleAxis<double> Mpitch(pitch, Eigen::Vector3d::UnitX());
+    Eigen::AngleAxis<double> Mroll(roll, Eigen::Vector3d::UnitZ());
+
+    return Myaw.toRotationMatrix() * Mpitch.toRotationMatrix() * Mroll.toRotationMatrix();
 }
 
 Surface::Surface(int subdivisions, QObject* parent)
@@ -29,52 +164,83 @@ Surface::Surface(int subdivisions, QObject* parent)
 {
     updateSubdivisions(subdivisions);
     connect(this, &Surface::sfmDataChanged, this, &Surface::msfmDataUpdate);
-    connect(this, &Surface::anglesChanged, this, &Surface::verticesChanged);
 }
 
-Surface::~Surface() {}
+Surface::~Surface()
+{
+    // Abort the computations in progress, if any
+    _verticesRequestId->fetchAndAddOrdered(1);
+    _stMapRequestId->fetchAndAddOrdered(1);
+}
 
-void Surface::update(QSGGeometry::TexturedPoint2D* vertices, quint16* indices, QSize textureSize, int downscaleLevel)
+void Surface::update(QSGGeometry::TexturedPoint2D* vertices, quint32* indices, QSize textureSize, int downscaleLevel)
 {
     // Compute Vertices coordinates and Indices order
     computeGrid(vertices, indices, textureSize, downscaleLevel);
-
-    // If Panorama has been rotated, reset values and return true
-    if (_isPanoramaRotating)
-        _isPanoramaRotating = false;
 }
 
 // GRID METHODS
-void Surface::computeGrid(QSGGeometry::TexturedPoint2D* vertices, quint16* indices, QSize textureSize, int downscaleLevel)
+void Surface::computeGrid(QSGGeometry::TexturedPoint2D* vertices, quint32* indices, QSize textureSize, int downscaleLevel)
 {
-    aliceVision::camera::IntrinsicBase* intrinsic = nullptr;
-    bool verticesComputed = false;
-    if (_sfmLoaded && (_isPanoramaRotating || _needToUseIntrinsic))
+    if (_sfmLoaded && _needToUseIntrinsic)
     {
         // Load Intrinsic with 2 ways whether we are in the Panorama or Distorsion Viewer
-        if (_msfmData)
-        {
-            intrinsic = getIntrinsicFromViewId(_idView);
-        }
-
+        aliceVision::camera::IntrinsicBase* intrinsic = _currentViewEntry ? _currentViewEntry->intrinsic : nullptr;
         if (intrinsic)
         {
-            computeVerticesGrid(vertices, textureSize, intrinsic, downscaleLevel);
-            verticesComputed = true;
-            setVerticesChanged(true);
-            Q_EMIT verticesChanged();
             _needToUseIntrinsic = false;
-        }
-        else
-        {
-            verticesComputed = false;
+
+            // The distortion mesh only depends on the intrinsic: reuse it if it has already been computed for another view
+            std::optional<MeshKey> key;
+            if (isDistortionViewerEnabled())
+            {
+                key = MeshKey{
+                  _currentViewEntry->intrinsicId, intrinsic->hashValue(), textureSize.width(), textureSize.height(), _subdivisions, _cropFisheye};
+            }
+
+            std::shared_ptr<const Vertices> mesh = key && !isStMapEnabled() ? findMesh(*key) : nullptr;
+            if (isStMapEnabled())
+            {
+                // The grid stays regular, the undistortion is done in the shader
+                updateStMap(*key, intrinsic, textureSize);
+            }
+            else if (mesh)
+            {
+                // Results of the computations in progress are outdated
+                _verticesRequestId->fetchAndAddOrdered(1);
+                _pendingMeshKey.reset();
+                _computedVertices = mesh;
+            }
+            else
+            {
+                launchVerticesComputation(textureSize, intrinsic, downscaleLevel);
+                _pendingMeshKey = key;
+            }
         }
     }
-    // If there is no sfm data update or intrinsics are invalid, keep the same vertices
-    if (!verticesComputed)
+
+    if (!isStMapEnabled() && _computedVertices && _computedVertices->size() == static_cast<size_t>(_vertexCount))
     {
-        computeVerticesGrid(vertices, textureSize, nullptr);
-        setVerticesChanged(false);
+        // Vertices computed from the intrinsic are available
+        std::copy(_computedVertices->begin(), _computedVertices->end(), vertices);
+        _circularMesh = _cropFisheye && getIntrinsicEquidistant();
+    }
+    else
+    {
+        // If there is no sfm data update or intrinsics are invalid, keep the same vertices
+        computeVerticesGrid(vertices, textureSize);
+        _circularMesh = false;
+    }
+    setVerticesChanged(false);
+
+    // The part of the image past the seam is drawn by a second copy of the mesh, unwrapped on the other side of the panorama.
+    // The copy is split from the vertices once per pose: its longitudes are offset by a multiple of 2 pi to identify it in the vertex shader.
+    if (isPanoramaViewerEnabled())
+    {
+        std::transform(vertices, vertices + _vertexCount, vertices + _vertexCount, [](QSGGeometry::TexturedPoint2D vertex) {
+            vertex.x += panoramaSeamCopyOffset;
+            return vertex;
+        });
     }
 
     computeIndicesGrid(indices);
@@ -82,268 +248,280 @@ void Surface::computeGrid(QSGGeometry::TexturedPoint2D* vertices, quint16* indic
 
 void Surface::computeGrid(QSGGeometry* geometryLine)
 {
-    removeGrid(geometryLine);
+    // Nothing to draw until the surface has been updated once
+    if (_vertices.size() != static_cast<size_t>(_vertexCount) || geometryLine->vertexCount() < _indexCount)
+    {
+        removeGrid(geometryLine);
+        return;
+    }
 
-    int countPoint = 0;
-    int index = 0;
+    updatePanoramaPickingVertices();
+    QSGGeometry::Point2D* points = geometryLine->vertexDataAsPoint2D();
+    const bool panorama = isPanoramaViewerEnabled();
+    const auto addLine = [&](int first, int second) {
+        const QPointF start = getDisplayedVertex(static_cast<size_t>(first));
+        const QPointF end = getDisplayedVertex(static_cast<size_t>(second));
+        // Lines straddling the longitude where a panorama image is unwrapped would cross the whole panorama: collapse them
+        const bool cut = panorama && std::abs(end.x() - start.x()) > 0.5 * _panoramaWidth;
+        (points++)->set(static_cast<float>(start.x()), static_cast<float>(start.y()));
+        if (cut)
+            (points++)->set(static_cast<float>(start.x()), static_cast<float>(start.y()));
+        else
+            (points++)->set(static_cast<float>(end.x()), static_cast<float>(end.y()));
+    };
+
+    const int rowSize = _subdivisions + 1;
     for (int i = 0; i <= _subdivisions; i++)
     {
         for (int j = 0; j <= _subdivisions; j++)
         {
-            if (i == _subdivisions && j == _subdivisions)
-                continue;
+            const int index = i * rowSize + j;
 
             // Horizontal Lines
             if (i != _subdivisions)
             {
-                geometryLine->vertexDataAsPoint2D()[countPoint++].set(static_cast<float>(_vertices[index].x()),
-                                                                      static_cast<float>(_vertices[index].y()));
-                index += _subdivisions + 1;
-                geometryLine->vertexDataAsPoint2D()[countPoint++].set(static_cast<float>(_vertices[index].x()),
-                                                                      static_cast<float>(_vertices[index].y()));
-                index -= _subdivisions + 1;
-
-                if (j == _subdivisions)
-                {
-                    index++;
-                    continue;
-                }
+                addLine(index, index + rowSize);
             }
 
             // Vertical Lines
-            geometryLine->vertexDataAsPoint2D()[countPoint++].set(static_cast<float>(_vertices[index].x()), static_cast<float>(_vertices[index].y()));
-            index++;
-            geometryLine->vertexDataAsPoint2D()[countPoint++].set(static_cast<float>(_vertices[index].x()), static_cast<float>(_vertices[index].y()));
+            if (j != _subdivisions)
+            {
+                addLine(index, index + 1);
+            }
         }
     }
+
+    // Unused points (the geometry is sized for the surface indices) are collapsed
+    for (QSGGeometry::Point2D* end = geometryLine->vertexDataAsPoint2D() + geometryLine->vertexCount(); points != end; ++points)
+        points->set(0, 0);
 }
 
-void Surface::computeVerticesGrid(QSGGeometry::TexturedPoint2D* vertices,
-                                  QSize textureSize,
-                                  aliceVision::camera::IntrinsicBase* intrinsic,
-                                  int downscaleLevel)
+void Surface::computeVerticesGrid(QSGGeometry::TexturedPoint2D* vertices, QSize textureSize)
 {
-    // Retrieve pose if Panorama Viewer is enable
-    if (isPanoramaViewerEnabled() && intrinsic)
-    {
-        // Downscale image according to downscale level
-        textureSize *= pow(2.0, downscaleLevel);
-        resetValuesVertexEnabled();
-    }
-
-    // Retrieve pose
-    aliceVision::sfmData::CameraPose pose;
-    if (isPanoramaViewerEnabled() && intrinsic && _msfmData)
-    {
-        const auto viewIt = _msfmData->rawData().getViews().find(_idView);
-        const aliceVision::sfmData::View& view = *viewIt->second;
-        pose = _msfmData->rawData().getPose(view);
-    }
-
-    aliceVision::camera::Equidistant* eqcam = dynamic_cast<aliceVision::camera::Equidistant*>(intrinsic);
-    aliceVision::Vec2 center = {0, 0};
-    double radius = std::numeric_limits<double>::max();
-
-    if (eqcam)
-    {
-        center = {eqcam->getCircleCenterX(), eqcam->getCircleCenterY()};
-        radius = eqcam->getCircleRadius();
-    }
-
-    bool fillCoordsSphere = _defaultSphereCoordinates.empty();
     int vertexIndex = 0;
     float fSubdivisions = static_cast<float>(_subdivisions);
-    for (size_t i = 0; i <= static_cast<size_t>(_subdivisions); i++)
+    for (int i = 0; i <= _subdivisions; i++)
     {
-        for (size_t j = 0; j <= static_cast<size_t>(_subdivisions); j++)
+        for (int j = 0; j <= _subdivisions; j++)
         {
             float fI = static_cast<float>(i);
             float fJ = static_cast<float>(j);
             float x, y = 0.f;
 
-            /* The panorama viewer needs to use the previously computed vertices to compute the current ones,
-             * otherwise images will end up stacked together on the top-left corner.
+            /* In the panorama viewer, the vertices hold positions on the unit sphere: keep the previously computed ones
+             * until the new ones are available, or collapse the surface so that nothing is displayed meanwhile.
              * For anything other than the panorama viewer, the surface vertices should be recomputed from scratch
              * so the distorsions are not accumulated. */
-            if (_vertices.empty() || !isPanoramaViewerEnabled())
+            if (!isPanoramaViewerEnabled())
             {
                 x = fI * static_cast<float>(textureSize.width()) / fSubdivisions;
                 y = fJ * static_cast<float>(textureSize.height()) / fSubdivisions;
             }
-            else
+            else if (_vertices.size() == static_cast<size_t>(_vertexCount))
             {
-                x = static_cast<float>(_vertices[vertexIndex].x());
-                y = static_cast<float>(_vertices[vertexIndex].y());
+                x = _vertices[static_cast<size_t>(vertexIndex)].x;
+                y = _vertices[static_cast<size_t>(vertexIndex)].y;
             }
-
-            const double cx = x - center(0);
-            const double cy = y - center(1);
-            const double dist = std::hypot(cx, cy);
-            const double maxradius = 0.99 * radius;
-
-            if (dist > maxradius)
+            else
             {
-                x = static_cast<float>(center(0) + maxradius * cx / dist);
-                y = static_cast<float>(center(1) + maxradius * cy / dist);
+                x = 0.f;
+                y = 0.f;
             }
 
-            const float u = fI / fSubdivisions;
-            const float v = fJ / fSubdivisions;
+            vertices[vertexIndex].set(x, y, fI / fSubdivisions, fJ / fSubdivisions);
+            vertexIndex++;
+        }
+    }
+}
 
-            // Remove Distortion only if sfmData has been updated
-            if (isDistortionViewerEnabled() && intrinsic && intrinsic->hasDistortion())
-            {
-                const aliceVision::Vec2 undisto_pix(x, y);
-                const aliceVision::Vec2 disto_pix = intrinsic->getDistortedPixel(undisto_pix);
-                vertices[vertexIndex].set(static_cast<float>(disto_pix.x()), static_cast<float>(disto_pix.y()), u, v);
-            }
+void Surface::launchVerticesComputation(QSize textureSize, aliceVision::camera::IntrinsicBase* intrinsic, int downscaleLevel)
+{
+    SurfaceVerticesParams params;
+    params.subdivisions = _subdivisions;
+    params.textureSize = textureSize;
+    params.intrinsic.reset(intrinsic->clone());
+    params.panorama = isPanoramaViewerEnabled();
+    params.distort = isDistortionViewerEnabled();
+    params.cropFisheye = _cropFisheye;
+
+    if (params.panorama)
+    {
+        // Downscale image according to downscale level
+        params.textureSize *= pow(2.0, downscaleLevel);
+        params.sphereCoordinates = _defaultSphereCoordinates;
 
-            // Equirectangular Convertion only if sfmData has been updated
-            if (isPanoramaViewerEnabled() && intrinsic)
-            {
-                // Compute pixel coordinates on the Unit Sphere
-                if (fillCoordsSphere)
-                {
-                    // Image System Coordinates
-                    aliceVision::Vec2 uvCoord(x, y);
-                    const auto& transfromPose = pose.getTransform();
-                    _defaultSphereCoordinates.push_back(aliceVision::camera::applyIntrinsicExtrinsic(transfromPose, intrinsic, uvCoord));
-                }
+        // Retrieve pose
+        if (_currentViewEntry && _currentViewEntry->pose)
+        {
+            params.pose = *_currentViewEntry->pose;
+        }
+    }
 
-                // Rotate Panorama if some rotation values exist
-                aliceVision::Vec3 sphereCoordinates(_defaultSphereCoordinates[static_cast<size_t>(vertexIndex)]);
-                rotatePanorama(sphereCoordinates);
+    // Any computation in progress is now outdated
+    const int requestId = _verticesRequestId->fetchAndAddOrdered(1) + 1;
 
-                // Compute pixel coordinates in the panorama coordinate system
-                aliceVision::Vec2 panoramaCoordinates = toEquirectangular(sphereCoordinates, _panoramaWidth, _panoramaHeight);
+    auto runnable = new SurfaceVerticesRunnable(std::move(params), requestId, _verticesRequestId);
+    connect(runnable, &SurfaceVerticesRunnable::done, this, &Surface::onVerticesComputed);
+    QThreadPool::globalInstance()->start(runnable);
+}
 
-                // If image is on the seam
-                if (vertexIndex > 0 && j > 0)
-                {
-                    double deltaX = panoramaCoordinates.x() - vertices[vertexIndex - 1].x;
-                    if (abs(deltaX) > 0.7 * _panoramaWidth)
-                    {
-                        _vertexEnabled[i][j - 1] = false;
-                    }
-                }
-                if (vertexIndex >= (_subdivisions + 1))
-                {
-                    double deltaY = panoramaCoordinates.x() - vertices[vertexIndex - (_subdivisions + 1)].x;
-                    if (abs(deltaY) > 0.7 * _panoramaWidth && j > 0)
-                    {
-                        _vertexEnabled[i][j - 1] = false;
-                    }
-                }
-                vertices[vertexIndex].set(static_cast<float>(panoramaCoordinates.x()), static_cast<float>(panoramaCoordinates.y()), u, v);
-            }
+std::shared_ptr<const Surface::Vertices> Surface::findMesh(const MeshKey& key)
+{
+    for (auto it = _meshCache.begin(); it != _meshCache.end(); ++it)
+    {
+        if (it->first == key)
+        {
+            // Move it to the front so that it is the last one to be discarded
+            _meshCache.splice(_meshCache.begin(), _meshCache, it);
+            return _meshCache.front().second;
+        }
+    }
+    return nullptr;
+}
+
+void Surface::updateStMap(const MeshKey& key, aliceVision::camera::IntrinsicBase* intrinsic, QSize textureSize)
+{
+    // The ST-map does not depend on the subdivisions
+    MeshKey stMapKey = key;
+    stMapKey.subdivisions = 0;
 
-            // Default
-            if (!intrinsic)
+    for (auto it = _stMapCache.begin(); it != _stMapCache.end(); ++it)
+    {
+        if (it->first == stMapKey)
+        {
+            _stMapRequestId->fetchAndAddOrdered(1);
+            _pendingStMapKey.reset();
+            _stMapCache.splice(_stMapCache.begin(), _stMapCache, it);
+            if (_stMap != it->second)
             {
-                vertices[vertexIndex].set(x, y, u, v);
+                _stMap = it->second;
+                Q_EMIT stMapChanged();
             }
-            vertexIndex++;
+            return;
         }
     }
-    // End for loop
-    Q_EMIT verticesChanged();
+
+    // Already being computed
+    if (_pendingStMapKey && *_pendingStMapKey == stMapKey)
+        return;
+
+    // The previous ST-map stays displayed until the new one is available
+    const int requestId = _stMapRequestId->fetchAndAddOrdered(1) + 1;
+    _pendingStMapKey = stMapKey;
+
+    auto runnable = new StMapRunnable(std::shared_ptr<aliceVision::camera::IntrinsicBase>(intrinsic->clone()), textureSize, requestId, _stMapRequestId);
+    connect(runnable, &StMapRunnable::done, this, &Surface::onStMapComputed);
+    QThreadPool::globalInstance()->start(runnable);
 }
 
-bool Surface::isPointValid(size_t i, size_t j) const
+void Surface::onStMapComputed(int requestId, std::shared_ptr<const StMap> stMap)
 {
-    // Check if the point and all its neighbours are enabled
-    // If not, return false
-    if (!_vertexEnabled[i][j])
-        return false;
+    // Ignore results of outdated computations
+    if (requestId != _stMapRequestId->loadAcquire() || !_pendingStMapKey)
+        return;
 
-    if (i > 0)
-    {
-        if (!_vertexEnabled[i - 1][j])
-            return false;
-    }
+    _stMapCache.emplace_front(*_pendingStMapKey, stMap);
+    while (_stMapCache.size() > stMapCacheCapacity)
+        _stMapCache.pop_back();
+    _pendingStMapKey.reset();
 
-    if (j > 0)
-    {
-        if (!_vertexEnabled[i][j - 1])
-            return false;
-    }
+    _stMap = stMap;
+    Q_EMIT stMapChanged();
+}
 
-    if (i > 0 && j > 0)
-    {
-        if (!_vertexEnabled[i - 1][j - 1])
-            return false;
-    }
+void Surface::onVerticesComputed(int requestId, SurfaceVerticesData data)
+{
+    // Ignore results of outdated computations
+    if (requestId != _verticesRequestId->loadAcquire() || data.vertices.size() != static_cast<size_t>(_vertexCount))
+        return;
 
-    if (static_cast<int>(i) < _subdivisions + 1)
+    auto computedVertices = std::make_shared<const Vertices>(std::move(data.vertices));
+    _computedVertices = computedVertices;
+    if (_pendingMeshKey)
     {
-        if (!_vertexEnabled[i + 1][j])
-            return false;
-        if (j > 0 && !_vertexEnabled[i + 1][j - 1])
-            return false;
+        _meshCache.emplace_front(*_pendingMeshKey, computedVertices);
+        while (_meshCache.size() > meshCacheCapacity)
+            _meshCache.pop_back();
+        _pendingMeshKey.reset();
     }
-
-    if (static_cast<int>(j) < _subdivisions + 1)
+    if (!data.sphereCoordinates.empty())
     {
-        if (!_vertexEnabled[i][j + 1])
-            return false;
-        if (i > 0 && !_vertexEnabled[i - 1][j + 1])
-            return false;
+        _defaultSphereCoordinates = std::move(data.sphereCoordinates);
+        _panoramaCenter = data.center;
+        _panoramaRadius = data.radius;
     }
 
-    if (static_cast<int>(i) < _subdivisions + 1 && static_cast<int>(j) < _subdivisions + 1)
+    // Swap in the new vertices on the next frame
+    setVerticesChanged(true);
+    Q_EMIT verticesChanged();
+}
+
+void Surface::computeIndicesGrid(quint32* indices)
+{
+    // All the cells are drawn: the indices only depend on the subdivisions
+    if (_gridIndices.size() != static_cast<size_t>(_indexCount))
     {
-        if (!_vertexEnabled[i + 1][j + 1])
-            return false;
+        _gridIndices.resize(static_cast<size_t>(_indexCount));
+        size_t index = 0;
+        for (size_t j = 0; j < static_cast<size_t>(_subdivisions); j++)
+        {
+            for (size_t i = 0; i < static_cast<size_t>(_subdivisions); i++)
+            {
+                quint32 topLeft = static_cast<quint32>(i * static_cast<size_t>(_subdivisions + 1) + j);
+                quint32 topRight = topLeft + 1;
+                quint32 bottomLeft = topLeft + static_cast<quint32>(_subdivisions) + 1;
+                quint32 bottomRight = bottomLeft + 1;
+                _gridIndices[index++] = topLeft;
+                _gridIndices[index++] = bottomLeft;
+                _gridIndices[index++] = topRight;
+                _gridIndices[index++] = topRight;
+                _gridIndices[index++] = bottomLeft;
+                _gridIndices[index++] = bottomRight;
+            }
+        }
     }
 
-    return true;
+    _indices = _gridIndices;
+    writeIndices(indices);
+
+    // The cells of the panorama mesh crossing the cut of its unwrapping are dropped once the vertices are known
+    _panoramaIndicesChanged = true;
+    _panoramaCutCells = false;
 }
 
-void Surface::resetValuesVertexEnabled()
+void Surface::writeIndices(quint32* indices) const
 {
-    for (size_t i = 0; i <= static_cast<size_t>(_subdivisions); i++)
+    std::copy(_indices.begin(), _indices.end(), indices);
+
+    // The copy of the panorama mesh drawn across the seam uses the second half of the vertices
+    if (isPanoramaViewerEnabled())
     {
-        for (size_t j = 0; j <= static_cast<size_t>(_subdivisions); j++)
-        {
-            _vertexEnabled[j][i] = true;
-        }
+        const quint32 offset = static_cast<quint32>(_vertexCount);
+        std::transform(_indices.begin(), _indices.end(), indices + _indexCount, [offset](quint32 index) { return index + offset; });
     }
 }
 
-void Surface::computeIndicesGrid(quint16* indices)
+bool Surface::updatePanoramaIndices(quint32* indices)
 {
-    int index = 0;
-    for (size_t j = 0; j < static_cast<size_t>(_subdivisions); j++)
+    if (!_panoramaIndicesChanged || !isPanoramaViewerEnabled() || _gridIndices.size() != static_cast<size_t>(_indexCount))
+        return false;
+    _panoramaIndicesChanged = false;
+
+    // Only the images containing a pole cover all the longitudes: the others keep all their cells, whatever the rotation
+    const bool containsPole =
+      !_defaultSphereCoordinates.empty() && panoramaCapContainsPole(getPanoramaRotation() * _panoramaCenter, _panoramaRadius);
+    if (!containsPole && !_panoramaCutCells)
+        return false;
+
+    _indices = _gridIndices;
+    updatePanoramaPickingVertices();
+    if (containsPole && static_cast<size_t>(_panoramaPickingVertices.cols()) == _vertices.size())
     {
-        for (size_t i = 0; i < static_cast<size_t>(_subdivisions); i++)
-        {
-            if (!isPanoramaViewerEnabled() || (isPanoramaViewerEnabled() && isPointValid(i, j)))
-            {
-                int topLeft = (static_cast<int>(i) * (_subdivisions + 1)) + static_cast<int>(j);
-                int topRight = topLeft + 1;
-                int bottomLeft = topLeft + _subdivisions + 1;
-                int bottomRight = bottomLeft + 1;
-                indices[index++] = static_cast<quint16>(topLeft);
-                indices[index++] = static_cast<quint16>(bottomLeft);
-                indices[index++] = static_cast<quint16>(topRight);
-                indices[index++] = static_cast<quint16>(topRight);
-                indices[index++] = static_cast<quint16>(bottomLeft);
-                indices[index++] = static_cast<quint16>(bottomRight);
-            }
-            else
-            {
-                indices[index++] = 0;
-                indices[index++] = 0;
-                indices[index++] = 0;
-                indices[index++] = 0;
-                indices[index++] = 0;
-                indices[index++] = 0;
-            }
-        }
+        dropPanoramaCutCells(_panoramaPickingVertices, _panoramaWidth, 0, _indices.data(), _indices.size());
     }
-    _indices.clear();
-    for (size_t i = 0; i < static_cast<size_t>(_indexCount); i++)
-        _indices.append(indices[i]);
+    _panoramaCutCells = containsPole;
+    writeIndices(indices);
+    return true;
 }
 
 void Surface::removeGrid(QSGGeometry* geometryLine)
@@ -361,6 +539,7 @@ void Surface::setGridColor(const QColor& color)
 
     _gridColor = color;
     _gridColor.setAlpha(_gridOpacity);
+    _gridChanged = true;
     Q_EMIT gridColorChanged(color);
 }
 void Surface::setGridOpacity(const int& opacity)
@@ -372,6 +551,7 @@ void Surface::setGridOpacity(const int& opacity)
         return;
     _gridOpacity = int((opacity / 100.0) * 255);
     _gridColor.setAlpha(_gridOpacity);
+    _gridChanged = true;
     Q_EMIT gridOpacityChanged(opacity);
 }
 
@@ -381,6 +561,7 @@ void Surface::setDisplayGrid(bool display)
         return;
 
     _displayGrid = display;
+    _gridChanged = true;
     Q_EMIT displayGridChanged();
 }
 
@@ -404,14 +585,48 @@ QPointF Surface::getPrincipalPoint()
 }
 
 // VERTICES FUNCTION
-void Surface::fillVertices(QSGGeometry::TexturedPoint2D* vertices)
+void Surface::fillVertices(const QSGGeometry::TexturedPoint2D* vertices)
+{
+    _vertices.assign(vertices, vertices + _vertexCount);
+    _gridChanged = true;
+    _panoramaPickingChanged = true;
+
+    // Called from the render thread: notify QML from the thread owning the surface
+    QMetaObject::invokeMethod(this, &Surface::verticesChanged, Qt::QueuedConnection);
+}
+
+QList<QPoint> Surface::vertices() const
 {
-    _vertices.clear();
-    for (int i = 0; i < _vertexCount; i++)
+    updatePanoramaPickingVertices();
+    QList<QPoint> points;
+    points.reserve(static_cast<int>(_vertices.size()));
+    for (size_t index = 0; index < _vertices.size(); ++index)
+        points.append(getDisplayedVertex(index).toPoint());
+    return points;
+}
+
+QPointF Surface::vertex(int index) const
+{
+    if (index < 0 || static_cast<size_t>(index) >= _vertices.size())
+        return QPointF();
+
+    updatePanoramaPickingVertices();
+    return getDisplayedVertex(static_cast<size_t>(index));
+}
+
+QPointF Surface::getDisplayedVertex(std::size_t index) const
+{
+    if (isPanoramaViewerEnabled())
     {
-        QPoint p(static_cast<int>(vertices[i].x), static_cast<int>(vertices[i].y));
-        _vertices.append(p);
+        // Not projected yet
+        const Eigen::Index column = static_cast<Eigen::Index>(index);
+        if (column >= _panoramaPickingVertices.cols())
+            return QPointF();
+        return QPointF(_panoramaPickingVertices(0, column), _panoramaPickingVertices(1, column));
     }
+
+    const QSGGeometry::TexturedPoint2D& vertex = _vertices[index];
+    return QPointF(static_cast<qreal>(vertex.x), static_cast<qreal>(vertex.y));
 }
 
 // SUBDIVISIONS FUNCTIONS
@@ -422,10 +637,6 @@ void Surface::updateSubdivisions(int sub)
     // Update vertexCount and indexCount according to new subdivision count
     _vertexCount = (_subdivisions + 1) * (_subdivisions + 1);
     _indexCount = _subdivisions * _subdivisions * 6;
-
-    _vertexEnabled.resize(static_cast<size_t>(_subdivisions) + 1);
-    for (size_t i = 0; i < static_cast<size_t>(_subdivisions) + 1; i++)
-        _vertexEnabled[i].resize(static_cast<size_t>(_subdivisions) + 1);
 }
 
 void Surface::setSubdivisions(int newSubdivisions)
@@ -435,6 +646,7 @@ void Surface::setSubdivisions(int newSubdivisions)
 
     setHasSubdivisionsChanged(true);
     updateSubdivisions(newSubdivisions);
+    _gridChanged = true;
 
     clearVertices();
     setVerticesChanged(true);
@@ -442,16 +654,117 @@ void Surface::setSubdivisions(int newSubdivisions)
     Q_EMIT subdivisionsChanged();
 }
 
+void Surface::setCropFisheye(bool cropFisheye)
+{
+    if (_cropFisheye == cropFisheye)
+        return;
+
+    _cropFisheye = cropFisheye;
+
+    // The vertices of fisheye intrinsics are sampled differently
+    if (getIntrinsicEquidistant())
+    {
+        clearVertices();
+        setVerticesChanged(true);
+        _needToUseIntrinsic = true;
+    }
+    Q_EMIT cropFisheyeChanged();
+}
+
+void Surface::setUseStMap(bool useStMap)
+{
+    if (_useStMap == useStMap)
+        return;
+
+    _useStMap = useStMap;
+    clearVertices();
+    setVerticesChanged(true);
+    _needToUseIntrinsic = true;
+    Q_EMIT useStMapChanged();
+}
+
+void Surface::setAdaptiveSubdivisions(bool adaptive)
+{
+    if (_adaptiveSubdivisions == adaptive)
+        return;
+
+    _adaptiveSubdivisions = adaptive;
+    Q_EMIT adaptiveSubdivisionsChanged();
+
+    updateAdaptiveSubdivisions();
+}
+
+void Surface::updateAdaptiveSubdivisions()
+{
+    if (!_adaptiveSubdivisions || !isDistortionViewerEnabled() || !_sfmLoaded)
+        return;
+
+    const aliceVision::camera::IntrinsicBase* intrinsic = getIntrinsicFromViewId(_idView);
+    if (!intrinsic)
+        return;
+
+    setSubdivisions(intrinsic->hasDistortion() ? computeAdaptiveSubdivisions(*intrinsic) : adaptiveMinSubdivisions);
+}
+
+int Surface::computeAdaptiveSubdivisions(const aliceVision::camera::IntrinsicBase& intrinsic)
+{
+    const double width = static_cast<double>(intrinsic.w());
+    const double height = static_cast<double>(intrinsic.h());
+
+    // The distortion is the strongest along the borders and the diagonals of the image:
+    // measure the distance between the distorted middle of each grid segment and the middle of its distorted ends
+    const aliceVision::Vec2 corners[4] = {{0.0, 0.0}, {width, 0.0}, {width, height}, {0.0, height}};
+    const std::pair<int, int> lines[6] = {{0, 1}, {1, 2}, {2, 3}, {3, 0}, {0, 2}, {1, 3}};
+
+    double maxError = 0.0;
+    for (const auto& line : lines)
+    {
+        const aliceVision::Vec2& start = corners[line.first];
+        const aliceVision::Vec2 step = (corners[line.second] - start) / static_cast<double>(adaptiveReferenceSubdivisions);
+        aliceVision::Vec2 previous = intrinsic.getDistortedPixel(start);
+        for (int i = 1; i <= adaptiveReferenceSubdivisions; ++i)
+        {
+            const aliceVision::Vec2 current = intrinsic.getDistortedPixel(start + static_cast<double>(i) * step);
+            const aliceVision::Vec2 middle = intrinsic.getDistortedPixel(start + (static_cast<double>(i) - 0.5) * step);
+            maxError = std::max(maxError, (middle - 0.5 * (previous + current)).norm());
+            previous = current;
+        }
+    }
+
+    // Piecewise linear approximation error is proportional to the square of the segments length
+    const int subdivisions = static_cast<int>(std::ceil(adaptiveReferenceSubdivisions * std::sqrt(maxError / adaptiveMaxError)));
+    const int maxSubdivisions = std::max(adaptiveMinSubdivisions,
+                                         std::min(adaptiveMaxSubdivisions, static_cast<int>(std::max(width, height)) / adaptiveMinCellSize));
+
+    return std::clamp(subdivisions, adaptiveMinSubdivisions, maxSubdivisions);
+}
+
 // PANORAMA
-void Surface::rotatePanorama(aliceVision::Vec3& coordSphere)
+Eigen::Matrix3d Surface::getPanoramaRotation() const { return computePanoramaRotation(_yaw, _pitch, _roll); }
+
+double Surface::getPanoramaCenterLongitude() const
 {
-    Eigen::AngleAxis<double> Myaw(_yaw, Eigen::Vector3d::UnitY());
-    Eigen::AngleAxis<double> Mpitch(_pitch, Eigen::Vector3d::UnitX());
-    Eigen::AngleAxis<double> Mroll(_roll, Eigen::Vector3d::UnitZ());
+    const aliceVision::Vec3 center = getPanoramaRotation() * _panoramaCenter;
+    return std::atan2(center.x(), center.z());
+}
 
-    Eigen::Matrix3d cRo = Myaw.toRotationMatrix() * Mpitch.toRotationMatrix() * Mroll.toRotationMatrix();
+void Surface::updatePanoramaPickingVertices() const
+{
+    if (!isPanoramaViewerEnabled() || !_panoramaPickingChanged)
+        return;
+    _panoramaPickingChanged = false;
+
+    if (_vertices.empty() || _defaultSphereCoordinates.size() != _vertices.size())
+    {
+        _panoramaPickingVertices.resize(2, 0);
+        return;
+    }
 
-    coordSphere = cRo * coordSphere;
+    static_assert(sizeof(aliceVision::Vec3) == 3 * sizeof(double), "Unit sphere coordinates are mapped as a 3xN matrix");
+    const Eigen::Map<const Eigen::Matrix3Xd> sphereCoordinates(
+      _defaultSphereCoordinates.front().data(), 3, static_cast<Eigen::Index>(_defaultSphereCoordinates.size()));
+    _panoramaPickingVertices.resize(2, sphereCoordinates.cols());
+    toEquirectangular(sphereCoordinates, getPanoramaRotation(), _panoramaWidth, _panoramaHeight, getPanoramaCenterLongitude(), _panoramaPickingVertices);
 }
 
 double Surface::getPitch()
@@ -463,8 +776,10 @@ double Surface::getPitch()
 void Surface::setPitch(double pitchInDegrees)
 {
     _pitch = aliceVision::degreeToRadian(pitchInDegrees);
-    _isPanoramaRotating = true;
-    setVerticesChanged(true);
+    _panoramaPickingChanged = true;
+    _panoramaIndicesChanged = true;
+    // The grid lines are drawn at the projected positions of the vertices
+    _gridChanged = true;
 
     Q_EMIT anglesChanged();
 }
@@ -478,8 +793,10 @@ double Surface::getYaw()
 void Surface::setYaw(double yawInDegrees)
 {
     _yaw = aliceVision::degreeToRadian(yawInDegrees);
-    _isPanoramaRotating = true;
-    setVerticesChanged(true);
+    _panoramaPickingChanged = true;
+    _panoramaIndicesChanged = true;
+    // The grid lines are drawn at the projected positions of the vertices
+    _gridChanged = true;
 
     Q_EMIT anglesChanged();
 }
@@ -492,8 +809,10 @@ double Surface::getRoll()
 void Surface::setRoll(double rollInDegrees)
 {
     _roll = aliceVision::degreeToRadian(rollInDegrees);
-    _isPanoramaRotating = true;
-    setVerticesChanged(true);
+    _panoramaPickingChanged = true;
+    _panoramaIndicesChanged = true;
+    // The grid lines are drawn at the projected positions of the vertices
+    _gridChanged = true;
 
     Q_EMIT anglesChanged();
 }
@@ -520,22 +839,44 @@ void Surface::setIdView(int id)
         _idView = static_cast<uint>(id);
     else
         _idView = 0;
+    _currentViewEntry = findViewEntry(_idView);
+
+    updateAdaptiveSubdivisions();
 }
 
 // MOUSE FUNCTIONS
 bool Surface::isMouseInside(float mx, float my)
 {
-    QPointF P(mx, my);
+    // The panorama vertices are projected in the vertex shader: project them the same way
+    const bool panorama = isPanoramaViewerEnabled();
+    if (panorama)
+    {
+        updatePanoramaPickingVertices();
+        if (static_cast<size_t>(_panoramaPickingVertices.cols()) != _vertices.size())
+            return false;
+
+        // The part of the image past the seam is displayed on the other side of the panorama:
+        // the mesh only contains the shifted point if it crosses the seam on that side
+        if (isPointInsideMesh(QPointF(mx + static_cast<float>(_panoramaWidth), my)) ||
+            isPointInsideMesh(QPointF(mx - static_cast<float>(_panoramaWidth), my)))
+            return true;
+    }
+
+    return isPointInsideMesh(QPointF(mx, my));
+}
+
+bool Surface::isPointInsideMesh(const QPointF& P) const
+{
     bool inside = false;
 
-    for (int i = 0; i < indexCount(); i += 3)
+    for (size_t i = 0; i + 2 < _indices.size(); i += 3)
     {
-        if (i + 2 >= _indices.size())
+        if (std::max({_indices[i], _indices[i + 1], _indices[i + 2]}) >= _vertices.size())
             break;
 
-        QPointF A = _vertices[_indices[i]];
-        QPointF B = _vertices[_indices[i + 1]];
-        QPointF C = _vertices[_indices[i + 2]];
+        QPointF A = getDisplayedVertex(_indices[i]);
+        QPointF B = getDisplayedVertex(_indices[i + 1]);
+        QPointF C = getDisplayedVertex(_indices[i + 2]);
 
         // Compute vectors
         QPointF v0 = C - A;
@@ -585,9 +926,15 @@ void Surface::setViewerType(EViewerType type)
         return;
 
     _viewerType = type;
+    // The grid is only displayed in the distortion viewer
+    _gridChanged = true;
+    // The panorama geometry holds a second copy of the mesh
+    setHasSubdivisionsChanged(true);
     clearVertices();
     setVerticesChanged(true);
     Q_EMIT viewerTypeChanged();
+
+    updateAdaptiveSubdivisions();
 }
 
 bool Surface::isPanoramaViewerEnabled() const { return _viewerType == EViewerType::PANORAMA; }
@@ -611,6 +958,9 @@ void Surface::setMSfmData(MSfMData* sfmData)
     }
     _msfmData = sfmData;
 
+    // The entries of the view table point into the previous SfMData: rebuild it before any early return
+    updateViewTable();
+
     if (!_msfmData)
         return;
 
@@ -633,36 +983,234 @@ void Surface::setMSfmData(MSfMData* sfmData)
     Q_EMIT sfmDataChanged();
 }
 
-aliceVision::camera::IntrinsicBase* Surface::getIntrinsicFromViewId(unsigned int viewId) const
+void Surface::updateViewTable()
 {
-    if (!_msfmData)
-    {
-        return nullptr;
-    }
-    aliceVision::camera::IntrinsicBase* intrinsic = nullptr;
-    const auto viewIt = _msfmData->rawData().getViews().find(viewId);
-    if (viewIt == _msfmData->rawData().getViews().end())
+    _viewTable.clear();
+    _currentViewEntry = nullptr;
+    if (!_msfmData || _msfmData->status() != MSfMData::Ready)
+        return;
+
+    const aliceVision::sfmData::SfMData& sfmData = _msfmData->rawData();
+    _viewTable.reserve(sfmData.getViews().size());
+    for (const auto& viewIt : sfmData.getViews())
     {
-        return nullptr;
+        const aliceVision::sfmData::View& view = *viewIt.second;
+
+        ViewEntry entry;
+        entry.intrinsicId = view.getIntrinsicId();
+        entry.intrinsic = _msfmData->rawData().getIntrinsicPtr(entry.intrinsicId);
+        // Equidistant is the intrinsic for full circle fisheye cameras
+        entry.equidistant = dynamic_cast<const aliceVision::camera::Equidistant*>(entry.intrinsic);
+        if (sfmData.isPoseAndIntrinsicDefined(&view))
+            entry.pose = sfmData.getPose(view).getTransform();
+
+        _viewTable.emplace(viewIt.first, std::move(entry));
     }
-    const aliceVision::sfmData::View& view = *viewIt->second;
-    intrinsic = _msfmData->rawData().getIntrinsicPtr(view.getIntrinsicId());
 
-    return intrinsic;
+    _currentViewEntry = findViewEntry(_idView);
+}
+
+const Surface::ViewEntry* Surface::findViewEntry(aliceVision::IndexT viewId) const
+{
+    const auto it = _viewTable.find(viewId);
+    return it != _viewTable.end() ? &it->second : nullptr;
+}
+
+aliceVision::camera::IntrinsicBase* Surface::getIntrinsicFromViewId(unsigned int viewId) const
+{
+    const ViewEntry* entry = viewId == _idView ? _currentViewEntry : findViewEntry(viewId);
+    return entry ? entry->intrinsic : nullptr;
 }
 
 const aliceVision::camera::Equidistant* Surface::getIntrinsicEquidistant() const
 {
-    const aliceVision::camera::IntrinsicBase* intrinsic = getIntrinsicFromViewId(_idView);
-    if (!intrinsic)
+    return _currentViewEntry ? _currentViewEntry->equidistant : nullptr;
+}
+
+SurfaceVerticesRunnable::SurfaceVerticesRunnable(SurfaceVerticesParams params, int requestId, const std::shared_ptr<QAtomicInt>& latestRequestId)
+  : _params(std::move(params)),
+    _requestId(requestId),
+    _latestRequestId(latestRequestId)
+{}
+
+void SurfaceVerticesRunnable::run()
+{
+    const int subdivisions = _params.subdivisions;
+    const size_t gridSize = static_cast<size_t>(subdivisions) + 1;
+    aliceVision::camera::IntrinsicBase* intrinsic = _params.intrinsic.get();
+    const bool fillCoordsSphere = _params.panorama && _params.sphereCoordinates.size() != gridSize * gridSize;
+
+    SurfaceVerticesData data;
+    data.vertices.resize(gridSize * gridSize);
+    if (_params.panorama)
     {
-        return nullptr;
+        data.sphereCoordinates = std::move(_params.sphereCoordinates);
+        data.sphereCoordinates.resize(gridSize * gridSize);
     }
 
-    // Load equidistant intrinsic (the intrinsic for full circle fisheye cameras)
-    const aliceVision::camera::Equidistant* intrinsicEquidistant = dynamic_cast<const aliceVision::camera::Equidistant*>(intrinsic);
+    const aliceVision::camera::Equidistant* eqcam = dynamic_cast<const aliceVision::camera::Equidistant*>(intrinsic);
+    aliceVision::Vec2 center = {0, 0};
+    double radius = std::numeric_limits<double>::max();
+    if (eqcam)
+    {
+        center = {eqcam->getCircleCenterX(), eqcam->getCircleCenterY()};
+        radius = eqcam->getCircleRadius();
+    }
+    const double maxradius = 0.99 * radius;
+
+    // Fit the grid to the fisheye circle: the pixels outside of it are never rasterized
+    const bool circular = _params.cropFisheye && eqcam;
+    const double width = static_cast<double>(_params.textureSize.width());
+    const double height = static_cast<double>(_params.textureSize.height());
+
+    // Vertices are independent from each other: compute the rows in parallel
+    const float fSubdivisions = static_cast<float>(subdivisions);
+    parallelFor(static_cast<int>(gridSize), [&](int row) {
+        // Stop as soon as a newer computation has been requested
+        if (isOutdated())
+            return;
+
+        const size_t i = static_cast<size_t>(row);
+        for (size_t j = 0; j < gridSize; j++)
+        {
+            const size_t vertexIndex = i * gridSize + j;
+            const float fI = static_cast<float>(i);
+            const float fJ = static_cast<float>(j);
+            float x = fI * static_cast<float>(_params.textureSize.width()) / fSubdivisions;
+            float y = fJ * static_cast<float>(_params.textureSize.height()) / fSubdivisions;
+            float u = fI / fSubdivisions;
+            float v = fJ / fSubdivisions;
+
+            if (circular)
+            {
+                // Map the square grid on the disk (elliptical grid mapping), the topology of the grid is unchanged
+                const double a = 2.0 * u - 1.0;
+                const double b = 2.0 * v - 1.0;
+                x = static_cast<float>(std::clamp(center(0) + maxradius * a * std::sqrt(1.0 - 0.5 * b * b), 0.0, width));
+                y = static_cast<float>(std::clamp(center(1) + maxradius * b * std::sqrt(1.0 - 0.5 * a * a), 0.0, height));
+                u = static_cast<float>(x / width);
+                v = static_cast<float>(y / height);
+            }
+            else
+            {
+                const double cx = x - center(0);
+                const double cy = y - center(1);
+                const double dist = std::hypot(cx, cy);
+                if (dist > maxradius)
+                {
+                    x = static_cast<float>(center(0) + maxradius * cx / dist);
+                    y = static_cast<float>(center(1) + maxradius * cy / dist);
+                }
+            }
+
+            if (_params.panorama)
+            {
+                // Compute pixel coordinates on the Unit Sphere, their longitude and latitude are computed for the whole row below
+                if (fillCoordsSphere)
+                {
+                    const aliceVision::Vec2 uvCoord(x, y);
+                    data.sphereCoordinates[vertexIndex] = aliceVision::camera::applyIntrinsicExtrinsic(_params.pose, intrinsic, uvCoord);
+                }
+                data.vertices[vertexIndex].set(0.f, 0.f, u, v);
+            }
+            else if (_params.distort && intrinsic->hasDistortion())
+            {
+                const aliceVision::Vec2 undisto_pix(x, y);
+                const aliceVision::Vec2 disto_pix = intrinsic->getDistortedPixel(undisto_pix);
+                data.vertices[vertexIndex].set(static_cast<float>(disto_pix.x()), static_cast<float>(disto_pix.y()), u, v);
+            }
+            else
+            {
+                data.vertices[vertexIndex].set(x, y, u, v);
+            }
+        }
+
+        if (_params.panorama)
+        {
+            // Longitude and latitude of the whole row at once, the rotation and the projection in the panorama are done in the vertex shader
+            static_assert(sizeof(aliceVision::Vec3) == 3 * sizeof(double), "Unit sphere coordinates are mapped as a 3xN matrix");
+            const size_t rowStart = i * gridSize;
+            const Eigen::Map<const Eigen::Matrix3Xd> sphereCoordinates(data.sphereCoordinates[rowStart].data(), 3, static_cast<Eigen::Index>(gridSize));
+            Eigen::Matrix2Xd angles(2, static_cast<Eigen::Index>(gridSize));
+            toLongitudeLatitude(sphereCoordinates, angles);
+
+            for (size_t j = 0; j < gridSize; j++)
+            {
+                const Eigen::Index k = static_cast<Eigen::Index>(j);
+                data.vertices[rowStart + j].x = static_cast<float>(angles(0, k));
+                data.vertices[rowStart + j].y = static_cast<float>(angles(1, k));
+            }
+        }
+    });
+
+    if (isOutdated())
+        return;
+
+    // The unwrapping of the longitudes in the panorama is done around the direction of the center of the image
+    if (_params.panorama)
+    {
+        const aliceVision::Vec3 imageCenter = aliceVision::camera::applyIntrinsicExtrinsic(
+          _params.pose, intrinsic, aliceVision::Vec2(0.5 * _params.textureSize.width(), 0.5 * _params.textureSize.height()));
+        if (imageCenter.norm() > 0.0)
+            data.center = imageCenter.normalized();
+
+        // Bounds the longitudes covered by the image whatever the rotation of the panorama
+        double minCosine = 1.0;
+        for (const aliceVision::Vec3& sphereCoordinates : data.sphereCoordinates)
+            minCosine = std::min(minCosine, data.center.dot(sphereCoordinates.normalized()));
+        data.radius = std::acos(std::clamp(minCosine, -1.0, 1.0));
+    }
+
+    Q_EMIT done(_requestId, data);
+}
+
+StMapRunnable::StMapRunnable(const std::shared_ptr<aliceVision::camera::IntrinsicBase>& intrinsic,
+                             QSize imageSize,
+                             int requestId,
+                             const std::shared_ptr<QAtomicInt>& latestRequestId)
+  : _intrinsic(intrinsic),
+    _imageSize(imageSize),
+    _requestId(requestId),
+    _latestRequestId(latestRequestId)
+{}
+
+void StMapRunnable::run()
+{
+    if (_imageSize.isEmpty())
+        return;
+
+    const double width = static_cast<double>(_imageSize.width());
+    const double height = static_cast<double>(_imageSize.height());
+    const double scale = std::min(1.0, static_cast<double>(maxStMapSize) / std::max(width, height));
+
+    auto stMap = std::make_shared<StMap>();
+    stMap->size = QSize(std::max(1, static_cast<int>(std::lround(width * scale))), std::max(1, static_cast<int>(std::lround(height * scale))));
+    const size_t mapWidth = static_cast<size_t>(stMap->size.width());
+    stMap->data.resize(mapWidth * static_cast<size_t>(stMap->size.height()) * 2);
+
+    // The displayed point is at the center of each sample, its texture coordinates in the distorted image are stored
+    const double stepX = width / static_cast<double>(stMap->size.width());
+    const double stepY = height / static_cast<double>(stMap->size.height());
+    parallelFor(stMap->size.height(), [&](int row) {
+        // Stop as soon as a newer computation has been requested
+        if (isOutdated())
+            return;
+
+        float* values = stMap->data.data() + static_cast<size_t>(row) * mapWidth * 2;
+        const double y = (static_cast<double>(row) + 0.5) * stepY;
+        for (size_t col = 0; col < mapWidth; ++col)
+        {
+            const aliceVision::Vec2 displayed((static_cast<double>(col) + 0.5) * stepX, y);
+            const aliceVision::Vec2 source = _intrinsic->getUndistortedPixel(displayed);
+            values[col * 2] = static_cast<float>(source.x() / width);
+            values[col * 2 + 1] = static_cast<float>(source.y() / height);
+        }
+    });
+
+    if (isOutdated())
+        return;
 
-    return intrinsicEquidistant;
+    Q_EMIT done(_requestId, stMap);
 }
 
-}  // namespace qtAliceVision
\ No newline at end of file
+}  // namespace qtAliceVision
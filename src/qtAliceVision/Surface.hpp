@@ -2,17 +2,105 @@
 #define _USE_MATH_DEFINES
 
 #include <MSfMData.hpp>
+#include <PanoramaProjection.hpp>
+#include <StMapTexture.hpp>
+#include <QAtomicInt>
 #include <QQuickItem>
+#include <QRunnable>
 #include <QSGGeometry>
 #include <QVariant>
+#include <cmath>
+#include <list>
+#include <memory>
+#include <optional>
 #include <string>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include <aliceVision/camera/IntrinsicBase.hpp>
+#include <aliceVision/geometry/Pose3.hpp>
 #include <aliceVision/sfmData/SfMData.hpp>
 
 namespace qtAliceVision {
 
+/**
+ * @brief Utility structure to encapsulate the inputs of a surface vertices computation.
+ *
+ * All the data is copied so that the computation does not depend on the SfMData, which may be reloaded meanwhile.
+ */
+struct SurfaceVerticesParams
+{
+    int subdivisions = 0;
+
+    /// Size of the grid in pixels (full resolution)
+    QSize textureSize;
+
+    std::shared_ptr<aliceVision::camera::IntrinsicBase> intrinsic;
+
+    /// Pose of the view, only used in the panorama viewer
+    aliceVision::geometry::Pose3 pose;
+
+    /// Compute the vertices on the unit sphere
+    bool panorama = false;
+
+    /// Apply the distortion of the intrinsic to the vertices (distortion viewer only)
+    bool distort = false;
+
+    /// Fit the grid to the circle of Equidistant intrinsics, so that nothing is rasterized outside of it
+    bool cropFisheye = false;
+
+    /// Coordinates of the vertices on the unit sphere, computed if empty
+    std::vector<aliceVision::Vec3> sphereCoordinates;
+};
+
+/**
+ * @brief Utility structure to encapsulate the result of a surface vertices computation.
+ */
+struct SurfaceVerticesData
+{
+    /// In the panorama viewer, the position of each vertex holds the longitude and latitude of its point on the unit sphere
+    std::vector<QSGGeometry::TexturedPoint2D> vertices;
+
+    /// Coordinates of the vertices on the unit sphere (panorama viewer only, empty otherwise)
+    std::vector<aliceVision::Vec3> sphereCoordinates;
+
+    /// Direction of the center of the image on the unit sphere (panorama viewer only)
+    aliceVision::Vec3 center = aliceVision::Vec3(0.0, 0.0, 1.0);
+
+    /// Largest angle between the center of the image and its vertices on the unit sphere, in radians (panorama viewer only)
+    double radius = M_PI;
+};
+
+/**
+ * @brief Rotation of the panorama.
+ * @param[in] yaw rotation around the vertical axis, in radians
+ * @param[in] pitch rotation around the horizontal axis, in radians
+ * @param[in] roll rotation around the optical axis, in radians
+ */
+Eigen::Matrix3d computePanoramaRotation(double yaw, double pitch, double roll);
+
+/**
+ * @brief Rotate points of the unit sphere and project them in an equirectangular panorama.
+ *
+ * The points are processed as a whole with Eigen matrix and array operations, so that the rotation
+ * and the latitude computation are vectorised.
+ * This is the CPU counterpart of the projection done in the vertex shaders of the image and panorama viewers.
+ *
+ * @param[in] spherical coordinates of the points on the unit sphere (one point per column)
+ * @param[in] rotation rotation of the panorama
+ * @param[in] width width of the panorama in pixels
+ * @param[in] height height of the panorama in pixels
+ * @param[in] centerLongitude longitudes are unwrapped in [centerLongitude - pi, centerLongitude + pi[
+ * @param[out] panorama coordinates of the points in the panorama in pixels (one point per column)
+ */
+void toEquirectangular(const Eigen::Ref<const Eigen::Matrix3Xd>& spherical,
+                       const Eigen::Matrix3d& rotation,
+                       int width,
+                       int height,
+                       double centerLongitude,
+                       Eigen::Ref<Eigen::Matrix2Xd> panorama);
+
 /**
  * @brief Discretization of FloatImageViewer surface
  */
@@ -34,10 +122,20 @@ class Surface : public QObject
 
     Q_PROPERTY(EViewerType viewerType READ getViewerType WRITE setViewerType NOTIFY viewerTypeChanged)
 
+    /// Positions of the vertices, built on demand: prefer vertexCount and vertex(index) to access a few vertices
     Q_PROPERTY(QList<QPoint> vertices READ vertices NOTIFY verticesChanged)
 
+    Q_PROPERTY(int vertexCount READ getDisplayedVertexCount NOTIFY verticesChanged)
+
     Q_PROPERTY(int subdivisions READ getSubdivisions WRITE setSubdivisions NOTIFY subdivisionsChanged)
 
+    Q_PROPERTY(bool adaptiveSubdivisions READ getAdaptiveSubdivisions WRITE setAdaptiveSubdivisions NOTIFY adaptiveSubdivisionsChanged)
+
+    Q_PROPERTY(bool useStMap READ getUseStMap WRITE setUseStMap NOTIFY useStMapChanged)
+
+    /// Only display what is inside the circle of fisheye (Equidistant) intrinsics
+    Q_PROPERTY(bool cropFisheye READ getCropFisheye WRITE setCropFisheye NOTIFY cropFisheyeChanged)
+
     Q_PROPERTY(double yaw READ getYaw WRITE setYaw NOTIFY anglesChanged)
     Q_PROPERTY(double pitch READ getPitch WRITE setPitch NOTIFY anglesChanged)
     Q_PROPERTY(double roll READ getRoll WRITE setRoll NOTIFY anglesChanged)
@@ -47,16 +145,21 @@ class Surface : public QObject
     Surface& operator=(const Surface& other) = default;
     ~Surface();
 
-    void update(QSGGeometry::TexturedPoint2D* vertices, quint16* indices, QSize textureSize, int downscaleLevel = 0);
+    void update(QSGGeometry::TexturedPoint2D* vertices, quint32* indices, QSize textureSize, int downscaleLevel = 0);
 
     // Q_INVOKABLES
     Q_INVOKABLE QPointF getPrincipalPoint();
     Q_INVOKABLE bool isMouseInside(float mx, float my);
     Q_INVOKABLE void setIdView(int id);
+    /// Position of a displayed vertex (in the panorama viewer, projected with the current rotation), (0, 0) if the index is out of range
+    Q_INVOKABLE QPointF vertex(int index) const;
 
     // GRID
     void computeGrid(QSGGeometry* geometryLine);
     void removeGrid(QSGGeometry* geometryLine);
+    /// Whether the grid lines geometry or color need to be updated
+    bool hasGridChanged() const { return _gridChanged; }
+    void setGridChanged(bool change) { _gridChanged = change; }
 
     // GRID COLOR
     QColor getGridColor() const { return _gridColor; }
@@ -85,6 +188,30 @@ class Surface : public QObject
     void setHasSubdivisionsChanged(bool state) { _subdivisionsChanged = state; }
     Q_SIGNAL void subdivisionsChanged();
 
+    // ADAPTIVE SUBDIVISIONS
+    // In the distortion viewer, choose the subdivisions from the image size and the distortion magnitude
+    bool getAdaptiveSubdivisions() const { return _adaptiveSubdivisions; }
+    void setAdaptiveSubdivisions(bool adaptive);
+    Q_SIGNAL void adaptiveSubdivisionsChanged();
+
+    // ST-MAP
+    // In the distortion viewer, undistort per pixel in the shader through an ST-map instead of deforming the grid
+    bool getUseStMap() const { return _useStMap; }
+    void setUseStMap(bool useStMap);
+    bool isStMapEnabled() const { return _useStMap && isDistortionViewerEnabled(); }
+    /// ST-map of the current intrinsic, null if not computed yet
+    const std::shared_ptr<const StMap>& getStMap() const { return _stMap; }
+    Q_SIGNAL void useStMapChanged();
+    Q_SIGNAL void stMapChanged();
+
+    // FISHEYE CROP
+    // The vertices computed from Equidistant intrinsics are fitted to the circle of the fisheye
+    bool getCropFisheye() const { return _cropFisheye; }
+    void setCropFisheye(bool cropFisheye);
+    /// Whether the displayed mesh is fitted to the fisheye circle, in which case nothing has to be cropped in the shader
+    bool isMeshCircular() const { return _circularMesh; }
+    Q_SIGNAL void cropFisheyeChanged();
+
     // MSfmData
     MSfMData* getMSfmData() { return _msfmData; }
     void setMSfmData(MSfMData* sfmData);
@@ -108,23 +235,37 @@ class Surface : public QObject
     Q_SIGNAL void viewerTypeChanged();
 
     // VERTICES
-    const QList<QPoint>& vertices() const { return _vertices; }
+    QList<QPoint> vertices() const;
+    /// Number of vertices currently displayed, 0 until the first surface update
+    int getDisplayedVertexCount() const { return static_cast<int>(_vertices.size()); }
     inline bool hasVerticesChanged() const { return _verticesChanged; }
     void setVerticesChanged(bool change) { _verticesChanged = change; }
     void clearVertices()
     {
         _vertices.clear();
+        _indices.clear();
+        _gridChanged = true;
+        _panoramaPickingChanged = true;
         _defaultSphereCoordinates.clear();
+        _computedVertices.reset();
+        _circularMesh = false;
+
+        // Results of the computations in progress are outdated
+        _verticesRequestId->fetchAndAddOrdered(1);
     }
 
     inline int indexCount() const { return _indexCount; }
     inline int vertexCount() const { return _vertexCount; }
+    /// Size of the surface geometry: in the panorama viewer, it holds a second copy of the mesh drawn across the seam
+    int geometryVertexCount() const { return isPanoramaViewerEnabled() ? 2 * _vertexCount : _vertexCount; }
+    int geometryIndexCount() const { return isPanoramaViewerEnabled() ? 2 * _indexCount : _indexCount; }
 
     Q_SIGNAL void verticesChanged();
 
     void setNeedToUseIntrinsic(bool state) { _needToUseIntrinsic = state; }
 
-    void fillVertices(QSGGeometry::TexturedPoint2D* vertices);
+    /// Keep a copy of the displayed vertices, used by the grid and the mouse picking
+    void fillVertices(const QSGGeometry::TexturedPoint2D* vertices);
 
     // Yaw
     double getYaw();
@@ -138,37 +279,136 @@ class Surface : public QObject
 
     Q_SIGNAL void anglesChanged();
 
+    // PANORAMA
+    // The panorama vertices are rotated and projected in the vertex shader
+    /// Rotation matrix of the panorama from the yaw, pitch and roll angles
+    Eigen::Matrix3d getPanoramaRotation() const;
+    QSize getPanoramaSize() const { return QSize(_panoramaWidth, _panoramaHeight); }
+    /// Longitude, in the rotated panorama, around which the vertices of the image are unwrapped
+    double getPanoramaCenterLongitude() const;
+    /// Direction of the center of the image on the unit sphere, without any rotation
+    const aliceVision::Vec3& getPanoramaCenter() const { return _panoramaCenter; }
+    /// Largest angle between the center of the image and its vertices on the unit sphere
+    double getPanoramaRadius() const { return _panoramaRadius; }
+    /**
+     * @brief Drop the cells of the panorama mesh crossing the longitude where it is unwrapped, if the image contains a pole.
+     * Only needed after the rotation or the vertices have changed, the other images keep all their cells.
+     * @param[out] indices index data of the surface geometry
+     * @return whether the indices have been updated
+     */
+    bool updatePanoramaIndices(quint32* indices);
+
     void msfmDataUpdate()
     {
+        updateViewTable();
         _sfmLoaded = true;
         _needToUseIntrinsic = true;
         clearVertices();
         setVerticesChanged(true);
+        updateAdaptiveSubdivisions();
 
         Q_EMIT verticesChanged();
     }
 
     const aliceVision::camera::Equidistant* getIntrinsicEquidistant() const;
 
+    /**
+     * @brief Slot called when the vertices computed from an intrinsic are ready.
+     * @param[in] requestId identifier of the computation
+     * @param[in] data computed vertices
+     */
+    Q_SLOT void onVerticesComputed(int requestId, SurfaceVerticesData data);
+
+    /**
+     * @brief Slot called when the ST-map of an intrinsic is ready.
+     * @param[in] requestId identifier of the computation
+     * @param[in] stMap computed ST-map
+     */
+    Q_SLOT void onStMapComputed(int requestId, std::shared_ptr<const StMap> stMap);
+
   private:
+    using Vertices = std::vector<QSGGeometry::TexturedPoint2D>;
+
+    /// Identification of a distortion mesh: views sharing an intrinsic share the same mesh
+    struct MeshKey
+    {
+        aliceVision::IndexT intrinsicId;
+        std::size_t intrinsicHash;
+        int width;
+        int height;
+        int subdivisions;
+        bool cropFisheye;
+
+        bool operator==(const MeshKey& other) const
+        {
+            return std::tie(intrinsicId, intrinsicHash, width, height, subdivisions, cropFisheye) ==
+                   std::tie(other.intrinsicId, other.intrinsicHash, other.width, other.height, other.subdivisions, other.cropFisheye);
+        }
+    };
+
     aliceVision::camera::IntrinsicBase* getIntrinsicFromViewId(unsigned int viewId) const;
 
-    void computeGrid(QSGGeometry::TexturedPoint2D* vertices, quint16* indices, QSize textureSize, int downscaleLevel = 0);
+    /// Intrinsic and pose of a view, resolved once per SfMData update
+    struct ViewEntry
+    {
+        aliceVision::IndexT intrinsicId = aliceVision::UndefinedIndexT;
+        aliceVision::camera::IntrinsicBase* intrinsic = nullptr;
+        /// The intrinsic if it is a fisheye (Equidistant) one, null otherwise
+        const aliceVision::camera::Equidistant* equidistant = nullptr;
+        /// Pose of the view, if it is defined
+        std::optional<aliceVision::geometry::Pose3> pose;
+    };
+
+    /// Rebuild the table of the views from the SfMData, so that the surface updates do not walk the SfMData maps
+    void updateViewTable();
+
+    /// Entry of a view in the table, null if the view is unknown
+    const ViewEntry* findViewEntry(aliceVision::IndexT viewId) const;
+
+    /**
+     * @brief Retrieve a previously computed distortion mesh.
+     * @return the mesh vertices if they are in the cache, otherwise nullptr
+     */
+    std::shared_ptr<const Vertices> findMesh(const MeshKey& key);
+
+    /// Use the ST-map of an intrinsic, computing it in worker threads if it is not in the cache
+    void updateStMap(const MeshKey& key, aliceVision::camera::IntrinsicBase* intrinsic, QSize textureSize);
+
+    void computeGrid(QSGGeometry::TexturedPoint2D* vertices, quint32* indices, QSize textureSize, int downscaleLevel = 0);
+
+    /// Compute the vertices of a regular grid (or keep the current ones in the panorama viewer)
+    void computeVerticesGrid(QSGGeometry::TexturedPoint2D* vertices, QSize textureSize);
 
-    void computeVerticesGrid(QSGGeometry::TexturedPoint2D* vertices,
-                             QSize textureSize,
-                             aliceVision::camera::IntrinsicBase* intrinsic,
-                             int downscaleLevel = 0);
+    /**
+     * @brief Compute the vertices from an intrinsic in worker threads.
+     * The current vertices stay displayed until the new ones are swapped in by onVerticesComputed.
+     */
+    void launchVerticesComputation(QSize textureSize, aliceVision::camera::IntrinsicBase* intrinsic, int downscaleLevel);
 
-    void computeIndicesGrid(quint16* indices);
+    /// Compute the indices of the grid cells and keep a copy of them, used by the mouse picking
+    void computeIndicesGrid(quint32* indices);
 
-    void rotatePanorama(aliceVision::Vec3& coordSphere);
+    /// Write the indices of the cells in the geometry, followed by those of the copy of the panorama mesh
+    void writeIndices(quint32* indices) const;
+
+    /// Project the panorama vertices with the current rotation, as done in the vertex shader, for the mouse picking
+    void updatePanoramaPickingVertices() const;
+    /// Position of a vertex as displayed: in the panorama viewer, the vertices hold angles and are projected in the panorama
+    QPointF getDisplayedVertex(std::size_t index) const;
+    /// Whether a point is inside one of the triangles of the displayed surface
+    bool isPointInsideMesh(const QPointF& P) const;
 
     void updateSubdivisions(int sub);
 
-    bool isPointValid(std::size_t i, std::size_t j) const;
+    /// Set the subdivisions needed to render the distortion of the current intrinsic without visible faceting
+    void updateAdaptiveSubdivisions();
 
-    void resetValuesVertexEnabled();
+    /**
+     * @brief Estimate the subdivisions needed to render the distortion of an intrinsic.
+     * @param[in] intrinsic intrinsic with distortion
+     * @return number of subdivisions for which the piecewise linear grid stays within a fraction of pixel of the distortion
+     */
+    static int computeAdaptiveSubdivisions(const aliceVision::camera::IntrinsicBase& intrinsic);
 
     // Get pitch / yaw / roll in radians and return degrees angle in the correct interval
     double getEulerAngleDegrees(double angleRadians);
@@ -177,22 +417,23 @@ class Surface : public QObject
     const int _panoramaWidth = 3000;
     const int _panoramaHeight = 1500;
 
-    // Vertex Data
-    QList<QPoint> _vertices;
-    QList<quint16> _indices;
+    // Vertex Data (copy of the displayed geometry)
+    Vertices _vertices;
+    std::vector<quint32> _indices;
     int _subdivisions;
     int _vertexCount;
     int _indexCount;
-    std::vector<std::vector<bool>> _vertexEnabled;
 
     // Vertices State
     bool _verticesChanged = true;
 
     // Grid State
+    bool _gridChanged = true;
     bool _displayGrid;
     QColor _gridColor = QColor(255, 0, 0, 255);
     int _gridOpacity = 255;
     bool _subdivisionsChanged = false;
+    bool _adaptiveSubdivisions = false;
 
     // SfmData
     MSfMData* _msfmData = nullptr;
@@ -202,7 +443,12 @@ class Surface : public QObject
     bool _needToUseIntrinsic = true;
 
     // Id View
-    aliceVision::IndexT _idView;
+    aliceVision::IndexT _idView = 0;
+
+    // Intrinsic and pose of each view of the SfMData
+    std::unordered_map<aliceVision::IndexT, ViewEntry> _viewTable;
+    // Entry of the current view in the table, null if unknown
+    const ViewEntry* _currentViewEntry = nullptr;
 
     // Viewer
     EViewerType _viewerType = EViewerType::DEFAULT;
@@ -215,10 +461,118 @@ class Surface : public QObject
 
     // Coordinates on Unit Sphere without any rotation
     std::vector<aliceVision::Vec3> _defaultSphereCoordinates;
+    // Direction of the center of the image on the unit sphere, without any rotation
+    aliceVision::Vec3 _panoramaCenter = aliceVision::Vec3(0.0, 0.0, 1.0);
+    // Largest angle between the center of the image and its vertices on the unit sphere
+    double _panoramaRadius = M_PI;
+    // The indices need to be checked for cells crossing the cut of the unwrapping of an image containing a pole
+    bool _panoramaIndicesChanged = true;
+    // Some cells have been dropped from the indices
+    bool _panoramaCutCells = false;
+    // Positions of the vertices in the rotated panorama, only computed on demand for the mouse picking, the grid and the vertex queries
+    mutable Eigen::Matrix2Xd _panoramaPickingVertices;
+    mutable bool _panoramaPickingChanged = true;
+    // Vertices computed from the intrinsic by the worker threads, null if not available
+    std::shared_ptr<const Vertices> _computedVertices;
+    // Distortion meshes of the latest intrinsics, most recently used first
+    std::list<std::pair<MeshKey, std::shared_ptr<const Vertices>>> _meshCache;
+    // Key of the mesh being computed by the worker threads, if it can be cached
+    std::optional<MeshKey> _pendingMeshKey;
+    // Indices of the regular grid, shared by all the meshes of the distortion viewer
+    std::vector<quint32> _gridIndices;
+
+    // ST-map of the current intrinsic, and of the latest intrinsics (most recently used first)
+    bool _useStMap = false;
+    std::shared_ptr<const StMap> _stMap;
+    bool _cropFisheye = false;
+    // The displayed mesh is fitted to the fisheye circle
+    bool _circularMesh = false;
+    std::list<std::pair<MeshKey, std::shared_ptr<const StMap>>> _stMapCache;
+    std::optional<MeshKey> _pendingStMapKey;
+    std::shared_ptr<QAtomicInt> _stMapRequestId = std::make_shared<QAtomicInt>(0);
+    // Identifier of the latest vertices computation, shared with the worker threads to abort outdated computations
+    std::shared_ptr<QAtomicInt> _verticesRequestId = std::make_shared<QAtomicInt>(0);
     // Mouse Over
     bool _mouseOver = false;
-    // If panorama is currently rotating
-    bool _isPanoramaRotating = false;
 };
 
-}  // namespace qtAliceVision
\ No newline at end of file
+/**
+ * @brief QRunnable object dedicated to computing the vertices of a surface from an intrinsic.
+ *
+ * The rows of the grid are spread over the threads of the global thread pool.
+ */
+class SurfaceVerticesRunnable : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+  public:
+    /**
+     * @param[in] params inputs of the computation
+     * @param[in] requestId identifier of this computation
+     * @param[in] latestRequestId identifier of the latest computation, used to abort outdated computations
+     */
+    SurfaceVerticesRunnable(SurfaceVerticesParams params, int requestId, const std::shared_ptr<QAtomicInt>& latestRequestId);
+
+    /// Compute the vertices in a worker thread
+    Q_SLOT void run() override;
+
+    /**
+     * @brief Signal emitted when the vertices have been computed.
+     * @param[in] requestId identifier of the computation
+     * @param[in] data computed vertices
+     */
+    Q_SIGNAL void done(int requestId, SurfaceVerticesData data);
+
+  private:
+    bool isOutdated() const { return _latestRequestId->loadAcquire() != _requestId; }
+
+  private:
+    SurfaceVerticesParams _params;
+    int _requestId;
+    std::shared_ptr<QAtomicInt> _latestRequestId;
+};
+
+/**
+ * @brief QRunnable object dedicated to computing the ST-map of an intrinsic.
+ *
+ * The rows of the map are spread over the threads of the global thread pool.
+ */
+class StMapRunnable : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+  public:
+    /**
+     * @param[in] intrinsic intrinsic to undistort
+     * @param[in] imageSize size of the image in pixels
+     * @param[in] requestId identifier of this computation
+     * @param[in] latestRequestId identifier of the latest computation, used to abort outdated computations
+     */
+    StMapRunnable(const std::shared_ptr<aliceVision::camera::IntrinsicBase>& intrinsic,
+                  QSize imageSize,
+                  int requestId,
+                  const std::shared_ptr<QAtomicInt>& latestRequestId);
+
+    /// Compute the ST-map in a worker thread
+    Q_SLOT void run() override;
+
+    /**
+     * @brief Signal emitted when the ST-map has been computed.
+     * @param[in] requestId identifier of the computation
+     * @param[in] stMap computed ST-map
+     */
+    Q_SIGNAL void done(int requestId, std::shared_ptr<const StMap> stMap);
+
+  private:
+    bool isOutdated() const { return _latestRequestId->loadAcquire() != _requestId; }
+
+  private:
+    std::shared_ptr<aliceVision::camera::IntrinsicBase> _intrinsic;
+    QSize _imageSize;
+    int _requestId;
+    std::shared_ptr<QAtomicInt> _latestRequestId;
+};
+
+}  // namespace qtAliceVision
+
+Q_DECLARE_METATYPE(qtAliceVision::SurfaceVerticesData)
@@ -0,0 +1,54 @@
+#include "TextureRegistry.hpp"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QOpenGLContext>
+
+namespace qtAliceVision {
+
+TextureRegistry& TextureRegistry::forCurrentContext()
+{
+    // Each window has its own render thread and OpenGL context
+    static QMutex mutex;
+    static std::map<QOpenGLContext*, std::unique_ptr<TextureRegistry>> registries;
+
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    QMutexLocker lock(&mutex);
+    std::unique_ptr<TextureRegistry>& registry = registries[context];
+    if (!registry)
+    {
+        registry = std::make_unique<TextureRegistry>();
+        if (context)
+        {
+            QObject::connect(context, &QOpenGLContext::aboutToBeDestroyed, [context]() {
+                QMutexLocker destroyLock(&mutex);
+                registries.erase(context);
+            });
+        }
+    }
+    return *registry;
+}
+
+std::shared_ptr<FloatTexture> TextureRegistry::acquire(const Key& key, std::shared_ptr<FloatImage> image)
+{
+    std::weak_ptr<FloatTexture>& entry = _textures[key];
+    std::shared_ptr<FloatTexture> texture = entry.lock();
+    if (texture)
+        return texture;
+
+    texture = std::make_shared<FloatTexture>();
+    texture->setImage(image);
+    entry = texture;
+
+    // Forget the textures released since the last creation
+    for (auto it = _textures.begin(); it != _textures.end();)
+    {
+        if (it->second.expired())
+            it = _textures.erase(it);
+        else
+            ++it;
+    }
+    return texture;
+}
+
+}  // namespace qtAliceVision
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "FloatTexture.hpp"
+
+#include <QtGlobal>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+
+namespace qtAliceVision {
+
+/**
+ * @brief Textures of the images displayed by several viewers, shared so that each image is only uploaded once.
+ *
+ * Textures are identified by the source of their image and only referenced weakly by the registry:
+ * they are released as soon as no viewer displays them anymore.
+ * There is one registry per OpenGL context, which must only be used from the render thread of that context.
+ */
+class TextureRegistry
+{
+  public:
+    /// Source of the image of a texture
+    struct Key
+    {
+        std::string path;
+        /// Downscale factor of the image
+        int downscale = 1;
+        /// Last modification of the file, the texture of a file modified since then is not shared
+        qint64 lastModified = 0;
+        int width = 0;
+        int height = 0;
+
+        bool operator<(const Key& other) const
+        {
+            return std::tie(path, downscale, lastModified, width, height) <
+                   std::tie(other.path, other.downscale, other.lastModified, other.width, other.height);
+        }
+    };
+
+    /// Registry of the OpenGL context current on the calling thread
+    static TextureRegistry& forCurrentContext();
+
+    /**
+     * @brief Get the texture of an image, creating it if no other viewer displays the same image.
+     * @param[in] key source of the image
+     * @param[in] image image displayed by the texture, only used if the texture is created
+     * @return the shared texture
+     */
+    std::shared_ptr<FloatTexture> acquire(const Key& key, std::shared_ptr<FloatImage> image);
+
+    /// Number of textures in the registry, including released ones not yet removed
+    std::size_t size() const { return _textures.size(); }
+
+  private:
+    std::map<Key, std::weak_ptr<FloatTexture>> _textures;
+};
+
+}  // namespace qtAliceVision
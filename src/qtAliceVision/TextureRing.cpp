@@ -0,0 +1,63 @@
+#include "TextureRing.hpp"
+
+#include <algorithm>
+
+namespace qtAliceVision {
+
+std::shared_ptr<FloatTexture> TextureRing::get(const std::shared_ptr<FloatImage>& image) const
+{
+    const auto it = std::find_if(_entries.begin(), _entries.end(), [&image](const Entry& entry) { return entry.image == image; });
+    return it != _entries.end() ? it->texture : nullptr;
+}
+
+void TextureRing::update(const std::vector<std::shared_ptr<FloatImage>>& images, int maxUploads)
+{
+    std::vector<Entry> entries;
+    entries.reserve(images.size());
+
+    int uploads = 0;
+    for (const auto& image : images)
+    {
+        if (!image)
+            continue;
+
+        // Reuse resident textures
+        std::shared_ptr<FloatTexture> texture = get(image);
+        if (!texture)
+        {
+            texture = std::make_shared<FloatTexture>();
+            std::shared_ptr<FloatImage> srcImage = image;
+            texture->setImage(srcImage);
+            texture->setFiltering(QSGTexture::Nearest);
+            texture->setHorizontalWrapMode(QSGTexture::Repeat);
+            texture->setVerticalWrapMode(QSGTexture::Repeat);
+        }
+
+        // Upload ahead of time, within the budget of this frame
+        if (!texture->isUploaded() && uploads < maxUploads)
+        {
+            texture->upload();
+            ++uploads;
+        }
+
+        entries.push_back({image, texture});
+    }
+
+    // Textures of images that are not part of the ring anymore are released here
+    // (unless they are still used by a material)
+    _entries = std::move(entries);
+}
+
+std::vector<double> TextureRing::takeUploadTimes()
+{
+    std::vector<double> uploadTimes;
+    for (Entry& entry : _entries)
+    {
+        const double uploadTime = entry.texture->takeUploadTime();
+        if (uploadTime > 0.0)
+            uploadTimes.push_back(uploadTime);
+    }
+    return uploadTimes;
+}
+
+}  // namespace qtAliceVision
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "FloatTexture.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace qtAliceVision {
+
+/**
+ * @brief Ring of GPU-resident textures for the upcoming frames of a sequence.
+ *
+ * During playback, the frames following the displayed one are uploaded ahead of time,
+ * a few per rendered frame, so that displaying the next frame only requires swapping the texture.
+ *
+ * Textures are identified by the image they were created from (images are shared with the image cache).
+ * This object must only be used from the render thread, with the scene graph's OpenGL context current.
+ */
+class TextureRing
+{
+  public:
+    /**
+     * @brief Get the texture created from a given image.
+     * @param[in] image image displayed by the texture
+     * @return the texture if it is resident in the ring, otherwise nullptr
+     */
+    std::shared_ptr<FloatTexture> get(const std::shared_ptr<FloatImage>& image) const;
+
+    /**
+     * @brief Make the given images resident and release the textures of all the other images.
+     * @param[in] images images to keep resident, ordered by display priority
+     * @param[in] maxUploads maximum number of textures uploaded during this call
+     */
+    void update(const std::vector<std::shared_ptr<FloatImage>>& images, int maxUploads);
+
+    /**
+     * @brief Get the durations of the uploads done since the last call.
+     * @return upload durations in milliseconds
+     */
+    std::vector<double> takeUploadTimes();
+
+    /// Release all the textures.
+    void clear() { _entries.clear(); }
+
+    /// Number of textures in the ring.
+    std::size_t size() const { return _entries.size(); }
+
+  private:
+    struct Entry
+    {
+        std::shared_ptr<FloatImage> image;
+        std::shared_ptr<FloatTexture> texture;
+    };
+
+    std::vector<Entry> _entries;
+};
+
+}  // namespace qtAliceVision
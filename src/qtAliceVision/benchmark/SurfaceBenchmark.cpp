@@ -0,0 +1,160 @@
+#include <MSfMData.hpp>
+#include <Surface.hpp>
+
+#include <QGuiApplication>
+
+#include <aliceVision/camera/camera.hpp>
+#include <aliceVision/sfmData/SfMData.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Headless benchmark of the geometry path of the FloatImageViewer: Surface::update for the default, distortion
+ * and panorama viewers, on synthetic intrinsics and for a range of subdivisions.
+ * Everything runs on the CPU (offscreen platform), so that it can be run on machines without GPU.
+ *
+ * Usage: qtAliceVisionSurfaceBenchmark [iterations]
+ */
+
+using namespace qtAliceVision;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr unsigned int imageWidth = 4000;
+constexpr unsigned int imageHeight = 3000;
+constexpr aliceVision::IndexT viewId = 0;
+constexpr aliceVision::IndexT intrinsicId = 0;
+constexpr aliceVision::IndexT poseId = 0;
+
+/// Synthetic intrinsic with distortion, the focal length varies to never hit the mesh caches
+std::shared_ptr<aliceVision::camera::IntrinsicBase> createIntrinsic(aliceVision::camera::EINTRINSIC type, int iteration)
+{
+    const double focal = (type == aliceVision::camera::EQUIDISTANT_CAMERA_RADIAL3 ? 1200.0 : 3000.0) + iteration;
+    std::shared_ptr<aliceVision::camera::IntrinsicBase> intrinsic = aliceVision::camera::createIntrinsic(type, imageWidth, imageHeight, focal, focal);
+
+    auto distortion = std::dynamic_pointer_cast<aliceVision::camera::IntrinsicScaleOffsetDisto>(intrinsic);
+    if (distortion)
+        distortion->setDistortionParams({0.1, -0.05, 0.01});
+
+    auto equidistant = std::dynamic_pointer_cast<aliceVision::camera::Equidistant>(intrinsic);
+    if (equidistant)
+    {
+        equidistant->setCircleCenterX(0.5 * imageWidth);
+        equidistant->setCircleCenterY(0.5 * imageHeight);
+        equidistant->setCircleRadius(0.5 * imageHeight);
+    }
+    return intrinsic;
+}
+
+struct Result
+{
+    double msPerUpdate = 0.0;
+    double verticesPerSecond = 0.0;
+};
+
+/// Time the computation of the vertices of the surface, until they are ready to be displayed
+Result run(Surface& surface, MSfMData* msfmData, aliceVision::camera::EINTRINSIC type, int iterations)
+{
+    std::vector<QSGGeometry::TexturedPoint2D> vertices(static_cast<std::size_t>(surface.geometryVertexCount()));
+    std::vector<quint32> indices(static_cast<std::size_t>(surface.geometryIndexCount()));
+    const QSize textureSize(static_cast<int>(imageWidth), static_cast<int>(imageHeight));
+
+    double totalMs = 0.0;
+    for (int i = 0; i < iterations; ++i)
+    {
+        if (msfmData)
+        {
+            msfmData->rawData().getIntrinsics()[intrinsicId] = createIntrinsic(type, i);
+            surface.msfmDataUpdate();
+        }
+        else
+        {
+            surface.setVerticesChanged(true);
+        }
+
+        const Clock::time_point start = Clock::now();
+        surface.update(vertices.data(), indices.data(), textureSize);
+        surface.fillVertices(vertices.data());
+
+        // The vertices computed from the intrinsic are delivered through the event loop
+        if (msfmData)
+        {
+            while (!surface.hasVerticesChanged())
+                QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+            surface.update(vertices.data(), indices.data(), textureSize);
+            surface.fillVertices(vertices.data());
+        }
+        totalMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    Result result;
+    result.msPerUpdate = totalMs / iterations;
+    result.verticesPerSecond = surface.vertexCount() / (result.msPerUpdate * 1e-3);
+    return result;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    // No window system needed
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    qRegisterMetaType<SurfaceVerticesData>("SurfaceVerticesData");
+    qRegisterMetaType<std::shared_ptr<const StMap>>("std::shared_ptr<const StMap>");
+
+    const int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20;
+
+    // Synthetic SfMData with a single posed view
+    MSfMData msfmData;
+    auto sfmData = new aliceVision::sfmData::SfMData;
+    sfmData->getViews().emplace(viewId, std::make_shared<aliceVision::sfmData::View>("", viewId, intrinsicId, poseId, imageWidth, imageHeight));
+    sfmData->getPoses().emplace(poseId, aliceVision::sfmData::CameraPose(aliceVision::geometry::Pose3()));
+    sfmData->getIntrinsics().emplace(intrinsicId, createIntrinsic(aliceVision::camera::PINHOLE_CAMERA_RADIAL3, 0));
+    msfmData.onSfmDataReady(sfmData);
+
+    struct Config
+    {
+        const char* name;
+        Surface::EViewerType viewerType;
+        aliceVision::camera::EINTRINSIC intrinsicType;
+        bool useSfmData;
+    };
+    const Config configs[] = {
+      {"default", Surface::EViewerType::DEFAULT, aliceVision::camera::PINHOLE_CAMERA_RADIAL3, false},
+      {"distortion pinhole", Surface::EViewerType::DISTORTION, aliceVision::camera::PINHOLE_CAMERA_RADIAL3, true},
+      {"distortion fisheye", Surface::EViewerType::DISTORTION, aliceVision::camera::EQUIDISTANT_CAMERA_RADIAL3, true},
+      {"panorama pinhole", Surface::EViewerType::PANORAMA, aliceVision::camera::PINHOLE_CAMERA_RADIAL3, true},
+      {"panorama fisheye", Surface::EViewerType::PANORAMA, aliceVision::camera::EQUIDISTANT_CAMERA_RADIAL3, true},
+    };
+    const int subdivisionsSweep[] = {12, 32, 64, 128, 256, 512};
+
+    std::printf("%-20s %12s %12s %16s\n", "viewer", "subdivisions", "ms/update", "Mvertices/s");
+    for (const Config& config : configs)
+    {
+        for (const int subdivisions : subdivisionsSweep)
+        {
+            Surface surface(subdivisions);
+            surface.setViewerType(config.viewerType);
+            if (config.useSfmData)
+            {
+                surface.setMSfmData(&msfmData);
+                surface.setIdView(static_cast<int>(viewId));
+            }
+
+            const Result result = run(surface, config.useSfmData ? &msfmData : nullptr, config.intrinsicType, iterations);
+            std::printf("%-20s %12d %12.3f %16.2f\n", config.name, subdivisions, result.msPerUpdate, result.verticesPerSecond * 1e-6);
+        }
+    }
+
+    return 0;
+}
@@ -3,11 +3,13 @@
 #include "ImageServer.hpp"
 #include "FeaturesViewer.hpp"
 #include "FloatImageViewer.hpp"
+#include "ImageStats.hpp"
 #include "MFeatures.hpp"
 #include "MSfMDataStats.hpp"
 #include "MTracks.hpp"
 #include "MViewStats.hpp"
 #include "PanoramaViewer.hpp"
+#include "RenderStats.hpp"
 #include "Surface.hpp"
 #include "MFeatures.hpp"
 
@@ -52,11 +54,18 @@ class QtAliceVisionPlugin : public QQmlExtensionPlugin
         qmlRegisterType<FloatImageViewer>(uri, 1, 0, "FloatImageViewer");
         qmlRegisterType<Surface>(uri, 1, 0, "Surface");
         qmlRegisterType<PanoramaViewer>(uri, 1, 0, "PanoramaViewer");
+        qmlRegisterType<ImageStats>(uri, 1, 0, "ImageStats");
+        qmlRegisterType<RenderStats>(uri, 1, 0, "RenderStats");
         qRegisterMetaType<QPointF>("QPointF");
         qRegisterMetaType<FloatImage>();
         qRegisterMetaType<std::shared_ptr<FloatImage>>();
 
         qRegisterMetaType<Surface*>("Surface*");
+        qRegisterMetaType<SurfaceVerticesData>("SurfaceVerticesData");
+        qRegisterMetaType<std::shared_ptr<const StMap>>("std::shared_ptr<const StMap>");
+        qRegisterMetaType<ImageStats*>("ImageStats*");
+        qRegisterMetaType<RenderStats*>("RenderStats*");
+        qRegisterMetaType<ImageStatsData>("ImageStatsData");
 
         qRegisterMetaType<imgserve::RequestData>("RequestData");
         qRegisterMetaType<imgserve::RequestData>("imgserve::RequestData");